@@ -0,0 +1,349 @@
+#include <stdlib.h>
+#include "util.h"
+#include "common.h"
+#include "block.h"
+#include "bcache.h"
+
+/* Buffer que guarda em memória o conteúdo de um bloco do disco */
+typedef struct Buffer {
+    int block;
+    int dirty;
+    int dirtyIndex;         /* posição em dirtyBuffers enquanto dirty */
+    char* data;
+    struct Buffer* hashNext;
+    struct Buffer* lruPrev;
+    struct Buffer* lruNext;
+} Buffer;
+
+static Buffer* buffers = NULL;
+static int bufferSize = 0;
+static Buffer* hashTable[BCACHE_HASH_SIZE];
+
+/* Lista LRU: lruHead é o buffer usado mais recentemente e lruTail o menos recente */
+static Buffer* lruHead;
+static Buffer* lruTail;
+
+/* Buffers sujos, para que flush e commit não percorram todos os buffers */
+static Buffer* dirtyBuffers[BCACHE_NUM_BUFFERS];
+static int numDirty = 0;
+
+static BCacheStats stats;
+
+static int hash_block(int block) {
+    return block & (BCACHE_HASH_SIZE - 1);
+}
+
+static void lru_remove(Buffer* buf) {
+    if(buf->lruPrev != NULL)
+        buf->lruPrev->lruNext = buf->lruNext;
+    else
+        lruHead = buf->lruNext;
+
+    if(buf->lruNext != NULL)
+        buf->lruNext->lruPrev = buf->lruPrev;
+    else
+        lruTail = buf->lruPrev;
+
+    buf->lruPrev = NULL;
+    buf->lruNext = NULL;
+}
+
+static void lru_push_front(Buffer* buf) {
+    buf->lruPrev = NULL;
+    buf->lruNext = lruHead;
+
+    if(lruHead != NULL)
+        lruHead->lruPrev = buf;
+    else
+        lruTail = buf;
+
+    lruHead = buf;
+}
+
+static void hash_remove(Buffer* buf) {
+    Buffer** link = &hashTable[hash_block(buf->block)];
+
+    while(*link != NULL && *link != buf)
+        link = &(*link)->hashNext;
+
+    if(*link == buf)
+        *link = buf->hashNext;
+
+    buf->hashNext = NULL;
+}
+
+static void hash_insert(Buffer* buf) {
+    int index = hash_block(buf->block);
+
+    buf->hashNext = hashTable[index];
+    hashTable[index] = buf;
+}
+
+static Buffer* lookup(int block) {
+    Buffer* buf = hashTable[hash_block(block)];
+
+    while(buf != NULL && buf->block != block)
+        buf = buf->hashNext;
+
+    return buf;
+}
+
+static void mark_dirty(Buffer* buf) {
+    if(!buf->dirty) {
+        buf->dirty = 1;
+        buf->dirtyIndex = numDirty;
+        dirtyBuffers[numDirty++] = buf;
+    }
+}
+
+static void mark_clean(Buffer* buf) {
+    /* Retira o buffer da lista colocando o último no seu lugar */
+    if(buf->dirty) {
+        buf->dirty = 0;
+        dirtyBuffers[buf->dirtyIndex] = dirtyBuffers[--numDirty];
+        dirtyBuffers[buf->dirtyIndex]->dirtyIndex = buf->dirtyIndex;
+    }
+}
+
+static void write_back(Buffer* buf) {
+    block_write(buf->block, buf->data);
+    mark_clean(buf);
+    stats.writebacks++;
+}
+
+/* Obtém um buffer para o bloco, reaproveitando o menos usado recentemente se necessário */
+static Buffer* get_buffer(int block) {
+    /* Buffers livres (block == -1) ficam sempre no fim da lista LRU */
+    Buffer* buf = lruTail;
+
+    if(buf->block != -1) {
+        /* Escreve o conteúdo do buffer no disco antes de reaproveitá-lo */
+        if(buf->dirty)
+            write_back(buf);
+
+        hash_remove(buf);
+        stats.evictions++;
+    }
+
+    buf->block = block;
+    hash_insert(buf);
+
+    return buf;
+}
+
+void bcache_init(void) {
+    /* Aloca os buffers somente na primeira inicialização */
+    if(buffers == NULL) {
+        buffers = (Buffer*) malloc(BCACHE_NUM_BUFFERS * sizeof(Buffer));
+
+        for(int i = 0; i < BCACHE_NUM_BUFFERS; i++)
+            buffers[i].data = NULL;
+    }
+
+    /* Realoca os buffers quando o tamanho do bloco muda */
+    if(bufferSize != BLOCK_SIZE) {
+        for(int i = 0; i < BCACHE_NUM_BUFFERS; i++) {
+            free(buffers[i].data);
+            buffers[i].data = (char*) malloc(BLOCK_SIZE * sizeof(char));
+        }
+
+        bufferSize = BLOCK_SIZE;
+    }
+
+    bcache_invalidate();
+}
+
+void bcache_read(int block, char* mem) {
+    Buffer* buf = lookup(block);
+
+    if(buf != NULL) {
+        stats.hits++;
+    } else {
+        stats.misses++;
+
+        /* Carrega o bloco do disco para um novo buffer */
+        buf = get_buffer(block);
+        block_read(block, buf->data);
+    }
+
+    /* Move o buffer para o início da lista LRU */
+    lru_remove(buf);
+    lru_push_front(buf);
+
+    bcopy((unsigned char*) buf->data, (unsigned char*) mem, BLOCK_SIZE);
+}
+
+void bcache_write(int block, char* mem) {
+    Buffer* buf = lookup(block);
+
+    /* A escrita sobrescreve o bloco inteiro, então não é preciso lê-lo do disco */
+    if(buf != NULL) {
+        stats.hits++;
+    } else {
+        stats.misses++;
+        buf = get_buffer(block);
+    }
+
+    lru_remove(buf);
+    lru_push_front(buf);
+
+    bcopy((unsigned char*) mem, (unsigned char*) buf->data, BLOCK_SIZE);
+    mark_dirty(buf);
+}
+
+void bcache_update(int block, int offset, char* data, int length) {
+    /* Altera apenas length bytes do bloco a partir de offset, sem copiar o bloco inteiro */
+    Buffer* buf = lookup(block);
+
+    if(buf != NULL) {
+        stats.hits++;
+    } else {
+        stats.misses++;
+        buf = get_buffer(block);
+        block_read(block, buf->data);
+    }
+
+    lru_remove(buf);
+    lru_push_front(buf);
+
+    bcopy((unsigned char*) data, (unsigned char*) &buf->data[offset], length);
+    mark_dirty(buf);
+}
+
+void bcache_readv(block_io_t* iov, int count) {
+    /* Blocos que não estão na cache são lidos direto do disco, sem ocupar buffers */
+    block_io_t* misses = (block_io_t*) malloc(count * sizeof(block_io_t));
+    int numMisses = 0;
+
+    for(int i = 0; i < count; i++) {
+        Buffer* buf = lookup(iov[i].block);
+
+        if(buf != NULL) {
+            stats.hits++;
+            bcopy((unsigned char*) buf->data, (unsigned char*) iov[i].mem, BLOCK_SIZE);
+        } else {
+            stats.misses++;
+            misses[numMisses++] = iov[i];
+        }
+    }
+
+    /* Lê os blocos restantes agrupando os que são adjacentes no disco */
+    if(numMisses > 0)
+        block_readv(misses, numMisses);
+
+    free(misses);
+}
+
+void bcache_writev(block_io_t* iov, int count) {
+    /* Atualiza as cópias em cache e escreve todos os blocos direto no disco */
+    for(int i = 0; i < count; i++) {
+        Buffer* buf = lookup(iov[i].block);
+
+        if(buf != NULL) {
+            stats.hits++;
+            bcopy((unsigned char*) iov[i].mem, (unsigned char*) buf->data, BLOCK_SIZE);
+            mark_clean(buf);
+        } else {
+            stats.misses++;
+        }
+    }
+
+    block_writev(iov, count);
+}
+
+static int compare_buffers(const void* a, const void* b) {
+    return (*(Buffer**) a)->block - (*(Buffer**) b)->block;
+}
+
+static int compare_block_io(const void* a, const void* b) {
+    return ((block_io_t*) a)->block - ((block_io_t*) b)->block;
+}
+
+void bcache_commit(block_io_t* iov, int count) {
+    /* Como bcache_writev, mas os blocos sujos da cache (mapeamento, mapas de bits, inodes) vão junto com os
+       blocos de iov em uma única submissão ao dispositivo, com uma única espera pelo seu término */
+    block_io_t* batch = (block_io_t*) malloc((count + BCACHE_NUM_BUFFERS) * sizeof(block_io_t));
+    int numBlocks = 0;
+
+    /* Os blocos de iov deixam de estar sujos na cache, então não aparecem duas vezes na submissão */
+    for(int i = 0; i < count; i++) {
+        Buffer* buf = lookup(iov[i].block);
+
+        if(buf != NULL) {
+            stats.hits++;
+            bcopy((unsigned char*) iov[i].mem, (unsigned char*) buf->data, BLOCK_SIZE);
+            mark_clean(buf);
+        } else {
+            stats.misses++;
+        }
+
+        batch[numBlocks++] = iov[i];
+    }
+
+    for(int i = 0; i < numDirty; i++) {
+        batch[numBlocks].block = dirtyBuffers[i]->block;
+        batch[numBlocks].mem = dirtyBuffers[i]->data;
+        dirtyBuffers[i]->dirty = 0;
+        numBlocks++;
+    }
+
+    stats.writebacks += numDirty;
+    numDirty = 0;
+
+    /* Em ordem crescente, para que blocos adjacentes sejam agrupados */
+    qsort(batch, numBlocks, sizeof(block_io_t), compare_block_io);
+
+    block_submit(BLOCK_OP_WRITE, batch, numBlocks);
+    block_complete();
+
+    free(batch);
+}
+
+void bcache_flush(void) {
+    int count = numDirty;
+
+    if(buffers == NULL)
+        return;
+
+    /* Escreve os blocos em ordem crescente para que blocos adjacentes sejam agrupados */
+    qsort(dirtyBuffers, count, sizeof(Buffer*), compare_buffers);
+
+    block_io_t iov[BCACHE_NUM_BUFFERS];
+
+    for(int i = 0; i < count; i++) {
+        iov[i].block = dirtyBuffers[i]->block;
+        iov[i].mem = dirtyBuffers[i]->data;
+        dirtyBuffers[i]->dirty = 0;
+    }
+
+    numDirty = 0;
+    block_writev(iov, count);
+    stats.writebacks += count;
+
+    /* Pede ao dispositivo que torne as escritas duráveis */
+    block_sync();
+}
+
+void bcache_invalidate(void) {
+    if(buffers == NULL)
+        return;
+
+    /* Descarta todos os buffers, inclusive os sujos, sem escrevê-los no disco */
+    for(int i = 0; i < BCACHE_HASH_SIZE; i++)
+        hashTable[i] = NULL;
+
+    lruHead = NULL;
+    lruTail = NULL;
+    numDirty = 0;
+
+    for(int i = 0; i < BCACHE_NUM_BUFFERS; i++) {
+        buffers[i].block = -1;
+        buffers[i].dirty = 0;
+        buffers[i].hashNext = NULL;
+        lru_push_front(&buffers[i]);
+    }
+}
+
+void bcache_get_stats(BCacheStats* out) {
+    *out = stats;
+}
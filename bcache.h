@@ -0,0 +1,26 @@
+#ifndef BCACHE_INCLUDED
+#define BCACHE_INCLUDED
+
+/* Quantidade de buffers mantidos em memória e número de listas da tabela hash */
+#define BCACHE_NUM_BUFFERS 256
+#define BCACHE_HASH_SIZE 128
+
+typedef struct {
+    int hits;           /* leituras/escritas atendidas por um buffer já presente */
+    int misses;         /* acessos que precisaram carregar o bloco do disco */
+    int evictions;      /* buffers reaproveitados pela política LRU */
+    int writebacks;     /* blocos sujos efetivamente escritos no disco */
+} BCacheStats;
+
+void bcache_init(void);
+void bcache_read(int block, char* mem);
+void bcache_write(int block, char* mem);
+void bcache_update(int block, int offset, char* data, int length);
+void bcache_readv(block_io_t* iov, int count);
+void bcache_writev(block_io_t* iov, int count);
+void bcache_commit(block_io_t* iov, int count);
+void bcache_flush(void);
+void bcache_invalidate(void);
+void bcache_get_stats(BCacheStats* stats);
+
+#endif
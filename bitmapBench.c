@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "bitops.h"
+
+/* Compares the bitops.h kernels with the original bit-at-a-time scan used by
+   find_free_bit_number, on a full bitmap (a single free bit at the end) and
+   on a fragmented one (about 90% of the bits in use, at random). The bitmap
+   covers one 4096-byte block. */
+
+#define BENCH_BITS (4096 * 8)
+#define BENCH_BYTES (BENCH_BITS / 8)
+#define BENCH_ROUNDS 2000
+#define BENCH_RUN 8
+
+static char full[BENCH_BYTES];
+static char fragmented[BENCH_BYTES];
+static char work[BENCH_BYTES];
+
+static double now( void) {
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report( char *kernel, char *test, int ops, double elapsed) {
+	printf( "%-8s %-18s %12.0f ops/sec\n", kernel, test, ops / elapsed);
+}
+
+static int get_bit( char *bytes, int n) {
+	return ( bytes[n / 8] >> ( 7 - n % 8)) & 1;
+}
+
+static void set_bit( char *bytes, int n) {
+	bytes[n / 8] |= 1 << ( 7 - n % 8);
+}
+
+static void clear_bit( char *bytes, int n) {
+	bytes[n / 8] &= ~( 1 << ( 7 - n % 8));
+}
+
+/* The original allocator: first free bit from 0, one bit at a time */
+static int legacy_find_free( char *bitmap, int size) {
+	int i, j;
+
+	for ( i = 0; i < size; i++)
+		for ( j = 7; j > -1; j--)
+			if ( (( bitmap[i] >> j) & 1) == 0)
+				return 7 - j + ( i * 8);
+
+	return -1;
+}
+
+static int legacy_find_free_run( char *bitmap, int size, int count) {
+	int i, run = 0;
+
+	for ( i = 0; i < size; i++) {
+		run = get_bit( bitmap, i) ? 0 : run + 1;
+		if ( run == count)
+			return i - count + 1;
+	}
+
+	return -1;
+}
+
+static int legacy_popcount( char *bitmap, int size) {
+	int i, total = 0;
+
+	for ( i = 0; i < size; i++)
+		total += get_bit( bitmap, i);
+
+	return total;
+}
+
+/* Allocates every free bit of the fragmented bitmap, always searching from bit 0 */
+static int fill( int legacy) {
+	int bit, n = 0;
+
+	memcpy( work, fragmented, BENCH_BYTES);
+	for ( ;;) {
+		bit = legacy ? legacy_find_free( work, BENCH_BYTES) : bitops_find_free( work, BENCH_BITS, 0);
+		if ( bit == -1)
+			break;
+		set_bit( work, bit);
+		n++;
+	}
+
+	return n;
+}
+
+static void run( char *name, int legacy) {
+	double start;
+	int r, n, sink = 0;
+
+	start = now();
+	for ( r = 0; r < BENCH_ROUNDS; r++)
+		sink += legacy ? legacy_find_free( full, BENCH_BYTES) : bitops_find_free( full, BENCH_BITS, 0);
+	report( name, "first free (full)", BENCH_ROUNDS, now() - start);
+
+	start = now();
+	for ( r = n = 0; r < BENCH_ROUNDS / 100; r++)
+		n += fill( legacy);
+	report( name, "fill (fragmented)", n, now() - start);
+
+	start = now();
+	for ( r = 0; r < BENCH_ROUNDS; r++)
+		sink += legacy ? legacy_find_free_run( fragmented, BENCH_BITS, BENCH_RUN) : bitops_find_free_run( fragmented, BENCH_BITS, 0, BENCH_RUN);
+	report( name, "run of 8 (frag)", BENCH_ROUNDS, now() - start);
+
+	start = now();
+	for ( r = 0; r < BENCH_ROUNDS; r++)
+		sink += legacy ? legacy_popcount( fragmented, BENCH_BITS) : bitops_popcount( fragmented, BENCH_BITS);
+	report( name, "popcount (frag)", BENCH_ROUNDS, now() - start);
+
+	/* Keeps the compiler from discarding the searches */
+	if ( sink == 42)
+		printf( "\n");
+}
+
+int main( void) {
+	int i, kernel;
+	int kernels[] = { BITOPS_KERNEL_WORD, BITOPS_KERNEL_SSE2, BITOPS_KERNEL_AVX2 };
+
+	memset( full, 0xFF, BENCH_BYTES);
+	clear_bit( full, BENCH_BITS - 1);
+
+	srand( 42);
+	for ( i = 0; i < BENCH_BITS; i++)
+		if ( rand() % 10 != 0)
+			set_bit( fragmented, i);
+
+	/* Every implementation must agree with the original scan */
+	for ( i = 0; i < sizeof(kernels) / sizeof(int); i++) {
+		if ( bitops_use_kernel( kernels[i]) != 0)
+			continue;
+		if ( bitops_find_free( full, BENCH_BITS, 0) != legacy_find_free( full, BENCH_BYTES) ||
+		     bitops_find_free( fragmented, BENCH_BITS, 0) != legacy_find_free( fragmented, BENCH_BYTES) ||
+		     bitops_find_free_run( fragmented, BENCH_BITS, 0, BENCH_RUN) != legacy_find_free_run( fragmented, BENCH_BITS, BENCH_RUN) ||
+		     bitops_popcount( fragmented, BENCH_BITS) != legacy_popcount( fragmented, BENCH_BITS)) {
+			printf( "bitmapbench: %s kernel disagrees with the bit scan\n", bitops_kernel_name( kernels[i]));
+			return 1;
+		}
+	}
+
+	run( "bit", 1);
+
+	for ( i = 0; i < sizeof(kernels) / sizeof(int); i++) {
+		kernel = kernels[i];
+		if ( bitops_use_kernel( kernel) != 0) {
+			printf( "%-8s not supported by this CPU\n", bitops_kernel_name( kernel));
+			continue;
+		}
+		run( bitops_kernel_name( kernel), 0);
+	}
+
+	return 0;
+}
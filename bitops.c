@@ -0,0 +1,321 @@
+#include <string.h>
+#include "bitops.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BITOPS_X86
+#endif
+
+/* Os vetores de bits são percorridos 64 bits por vez. Como o bit de menor
+   número é o mais significativo de cada byte, os 8 bytes são lidos em ordem
+   big-endian e o primeiro bit procurado é encontrado contando os zeros à
+   esquerda da palavra (clz). Regiões totalmente ocupadas são puladas por uma
+   das funções skip_full, escolhida em tempo de execução conforme a CPU. */
+
+typedef unsigned long long word_t;
+
+#define WORD_BYTES 8
+#define ALL_ONES (~0ULL)
+
+static int skip_full_word(char* bits, int byte, int numBytes);
+
+static int (*skip_full)(char* bits, int byte, int numBytes) = skip_full_word;
+static int currentKernel = -1;
+
+/* Lê 8 bytes a partir de byte; bytes depois do fim do vetor recebem o valor pad */
+static word_t load_word(char* bits, int byte, int numBytes, unsigned char pad) {
+    word_t word;
+
+    if(byte + WORD_BYTES <= numBytes) {
+        memcpy(&word, &bits[byte], WORD_BYTES);
+    } else {
+        unsigned char tail[WORD_BYTES];
+
+        for(int i = 0; i < WORD_BYTES; i++)
+            tail[i] = byte + i < numBytes ? bits[byte + i] : pad;
+
+        memcpy(&word, tail, WORD_BYTES);
+    }
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    word = __builtin_bswap64(word);
+#endif
+
+    return word;
+}
+
+/* Retorna o primeiro byte (avançando de 8 em 8) cuja palavra não está totalmente ocupada */
+static int skip_full_word(char* bits, int byte, int numBytes) {
+    word_t word;
+
+    while(byte + WORD_BYTES <= numBytes) {
+        memcpy(&word, &bits[byte], WORD_BYTES);
+
+        if(word != ALL_ONES)
+            break;
+
+        byte += WORD_BYTES;
+    }
+
+    return byte;
+}
+
+/* Retorna o primeiro byte (avançando de 8 em 8) cuja palavra não está totalmente livre */
+static int skip_empty_word(char* bits, int byte, int numBytes) {
+    word_t word;
+
+    while(byte + WORD_BYTES <= numBytes) {
+        memcpy(&word, &bits[byte], WORD_BYTES);
+
+        if(word != 0)
+            break;
+
+        byte += WORD_BYTES;
+    }
+
+    return byte;
+}
+
+#ifdef BITOPS_X86
+__attribute__((target("sse2")))
+static int skip_full_sse2(char* bits, int byte, int numBytes) {
+    __m128i ones = _mm_set1_epi8(-1);
+
+    /* Compara 16 bytes por vez com 0xFF */
+    while(byte + 16 <= numBytes) {
+        __m128i chunk = _mm_loadu_si128((__m128i*) &bits[byte]);
+
+        if(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, ones)) != 0xFFFF)
+            break;
+
+        byte += 16;
+    }
+
+    return skip_full_word(bits, byte, numBytes);
+}
+
+__attribute__((target("avx2")))
+static int skip_full_avx2(char* bits, int byte, int numBytes) {
+    __m256i ones = _mm256_set1_epi8(-1);
+
+    /* Verifica 32 bytes por vez: testc é 1 quando todos os bits do bloco estão em 1 */
+    while(byte + 32 <= numBytes) {
+        __m256i chunk = _mm256_loadu_si256((__m256i*) &bits[byte]);
+
+        if(!_mm256_testc_si256(chunk, ones))
+            break;
+
+        byte += 32;
+    }
+
+    return skip_full_word(bits, byte, numBytes);
+}
+#endif
+
+static int kernel_supported(int kernel) {
+    if(kernel == BITOPS_KERNEL_WORD)
+        return 1;
+
+#ifdef BITOPS_X86
+    __builtin_cpu_init();
+
+    if(kernel == BITOPS_KERNEL_SSE2)
+        return __builtin_cpu_supports("sse2");
+
+    if(kernel == BITOPS_KERNEL_AVX2)
+        return __builtin_cpu_supports("avx2");
+#endif
+
+    return 0;
+}
+
+int bitops_use_kernel(int kernel) {
+    if(!kernel_supported(kernel))
+        return -1;
+
+    switch(kernel) {
+#ifdef BITOPS_X86
+    case BITOPS_KERNEL_SSE2:
+        skip_full = skip_full_sse2;
+        break;
+    case BITOPS_KERNEL_AVX2:
+        skip_full = skip_full_avx2;
+        break;
+#endif
+    default:
+        skip_full = skip_full_word;
+        break;
+    }
+
+    currentKernel = kernel;
+
+    return 0;
+}
+
+int bitops_kernel(void) {
+    /* Na primeira chamada escolhe a implementação mais larga suportada pela CPU */
+    if(currentKernel == -1) {
+        if(bitops_use_kernel(BITOPS_KERNEL_AVX2) != 0 && bitops_use_kernel(BITOPS_KERNEL_SSE2) != 0)
+            bitops_use_kernel(BITOPS_KERNEL_WORD);
+    }
+
+    return currentKernel;
+}
+
+char* bitops_kernel_name(int kernel) {
+    switch(kernel) {
+    case BITOPS_KERNEL_SSE2:
+        return "sse2";
+    case BITOPS_KERNEL_AVX2:
+        return "avx2";
+    default:
+        return "word";
+    }
+}
+
+/* Encontra o primeiro bit igual a value a partir de start, ou -1 se não houver */
+static int find_bit(char* bits, int size, int start, int value) {
+    int numBytes = (size + 7) / 8;
+
+    if(start < 0)
+        start = 0;
+
+    if(start >= size)
+        return -1;
+
+    bitops_kernel();
+
+    /* Bytes além do fim nunca são encontrados: ocupados ao procurar livres e vice-versa */
+    unsigned char pad = value ? 0x00 : 0xFF;
+    int byte = (start / 64) * WORD_BYTES;
+
+    /* Procura sempre por bits 1, invertendo a palavra quando o valor buscado é 0 */
+    word_t word = load_word(bits, byte, numBytes, pad);
+    if(!value)
+        word = ~word;
+
+    /* Descarta os bits anteriores a start na primeira palavra */
+    word &= ALL_ONES >> (start % 64);
+
+    while(word == 0) {
+        byte += WORD_BYTES;
+
+        if(byte < numBytes)
+            byte = value ? skip_empty_word(bits, byte, numBytes) : skip_full(bits, byte, numBytes);
+
+        if(byte >= numBytes)
+            return -1;
+
+        word = load_word(bits, byte, numBytes, pad);
+        if(!value)
+            word = ~word;
+    }
+
+    int bitNumber = byte * 8 + __builtin_clzll(word);
+
+    return bitNumber < size ? bitNumber : -1;
+}
+
+int bitops_find_free(char* bits, int size, int start) {
+    return find_bit(bits, size, start, 0);
+}
+
+int bitops_find_set(char* bits, int size, int start) {
+    return find_bit(bits, size, start, 1);
+}
+
+int bitops_find_free_run(char* bits, int size, int start, int count) {
+    int numBytes = (size + 7) / 8;
+
+    if(start < 0)
+        start = 0;
+
+    if(count < 1)
+        count = 1;
+
+    if(start >= size || count > size - start)
+        return -1;
+
+    bitops_kernel();
+
+    /* carry é o tamanho da sequência de bits livres que termina no fim da palavra anterior */
+    int carry = 0;
+    int runStart = -1;
+
+    for(int byte = (start / 64) * WORD_BYTES; byte < numBytes; byte += WORD_BYTES) {
+        /* Sem sequência em andamento, palavras totalmente ocupadas são puladas */
+        if(carry == 0) {
+            byte = skip_full(bits, byte, numBytes);
+
+            if(byte >= numBytes)
+                break;
+        }
+
+        /* freeBits tem 1 nos bits livres; bits antes de start ou depois do fim contam como ocupados */
+        word_t freeBits = ~load_word(bits, byte, numBytes, 0xFF);
+        int base = byte * 8;
+
+        if(base < start)
+            freeBits &= ALL_ONES >> (start - base);
+
+        if(size - base < 64)
+            freeBits &= ~(ALL_ONES >> (size - base));
+
+        if(freeBits == ALL_ONES) {
+            if(carry == 0)
+                runStart = base;
+
+            carry += 64;
+
+            if(carry >= count)
+                return runStart;
+
+            continue;
+        }
+
+        /* Bits livres no começo da palavra continuam a sequência anterior */
+        int leading = __builtin_clzll(~freeBits);
+
+        if(carry > 0 && carry + leading >= count)
+            return runStart;
+
+        /* Sequências inteiramente dentro da palavra: bit p de match indica count bits livres a partir de p */
+        if(count <= 64) {
+            word_t match = freeBits;
+
+            for(int length = 1; length < count && match != 0; ) {
+                int shift = length < count - length ? length : count - length;
+
+                match &= match << shift;
+                length += shift;
+            }
+
+            if(match != 0)
+                return base + __builtin_clzll(match);
+        }
+
+        /* Bits livres no fim da palavra iniciam uma nova sequência */
+        carry = freeBits == 0 ? 0 : __builtin_ctzll(~freeBits);
+        runStart = base + 64 - carry;
+    }
+
+    return -1;
+}
+
+int bitops_popcount(char* bits, int size) {
+    int numBytes = (size + 7) / 8;
+    int total = 0;
+
+    for(int byte = 0; byte < numBytes; byte += WORD_BYTES) {
+        word_t word = load_word(bits, byte, numBytes, 0x00);
+        int remaining = size - byte * 8;
+
+        /* Ignora os bits depois do fim do vetor na última palavra */
+        if(remaining < 64)
+            word &= ~(ALL_ONES >> remaining);
+
+        total += __builtin_popcountll(word);
+    }
+
+    return total;
+}
@@ -0,0 +1,23 @@
+#ifndef BITOPS_INCLUDED
+#define BITOPS_INCLUDED
+
+/* Operações sobre vetores de bits no formato dos mapas de bits do disco: o bit
+   de número b fica no byte b / 8, na posição 7 - (b % 8), e 1 indica ocupado. */
+
+/* Implementações disponíveis para pular regiões totalmente ocupadas */
+enum {
+    BITOPS_KERNEL_WORD,     /* 64 bits por vez */
+    BITOPS_KERNEL_SSE2,     /* 128 bits por vez */
+    BITOPS_KERNEL_AVX2      /* 256 bits por vez */
+};
+
+int bitops_use_kernel(int kernel);
+int bitops_kernel(void);
+char* bitops_kernel_name(int kernel);
+
+int bitops_find_free(char* bits, int size, int start);
+int bitops_find_set(char* bits, int size, int start);
+int bitops_find_free_run(char* bits, int size, int start, int count);
+int bitops_popcount(char* bits, int size);
+
+#endif
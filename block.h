@@ -2,15 +2,53 @@
 #define BLOCK_INCLUDED
 
 #define MAX_IMAGE_SIZE 256*1024
+
+/* Size in blocks of the default device (the image mkfs creates when no size is given) */
+#define FS_SIZE 2048
 //#define MAX_IMAGE_SIZE 128*1024
 
-#define BLOCK_SIZE_BITS 9
+/* The block size is chosen at run time with block_set_size (512 bytes up to 4 KB) */
+#define MIN_BLOCK_SIZE_BITS 9
+#define MAX_BLOCK_SIZE_BITS 12
+#define DEFAULT_BLOCK_SIZE_BITS 9
+
+extern int block_size_bits;
+
+#define BLOCK_SIZE_BITS block_size_bits
 #define BLOCK_SIZE (1 << BLOCK_SIZE_BITS)
 #define BLOCK_MASK (BLOCK_SIZE-1)
+#define MAX_BLOCK_SIZE (1 << MAX_BLOCK_SIZE_BITS)
+
+/* Backends available to block_init_backend */
+#define BLOCK_BACKEND_STDIO 0
+#define BLOCK_BACKEND_PIO 1
+#define BLOCK_BACKEND_MMAP 2
+#define BLOCK_BACKEND_ASYNC 3
+
+/* Operations accepted by block_submit */
+#define BLOCK_OP_READ 0
+#define BLOCK_OP_WRITE 1
+
+/* Backend used by block_init, may be overridden by the BLOCK_BACKEND environment variable */
+#define BLOCK_DEFAULT_BACKEND BLOCK_BACKEND_PIO
+
+/* One entry of a vectored request: block number and its memory buffer */
+typedef struct {
+	int block;
+	char *mem;
+} block_io_t;
 
 void bzero_block( char *block);
 void block_init( void);
+void block_init_backend( int backend);
+void block_set_size( int bits);
 void block_read( int block, char *mem);
 void block_write( int block, char *mem);
+void block_readv( block_io_t *iov, int count);
+void block_writev( block_io_t *iov, int count);
+void block_submit( int op, block_io_t *iov, int count);
+int block_complete( void);
+void block_sync( void);
+void block_truncate( void);
 
 #endif
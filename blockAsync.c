@@ -0,0 +1,545 @@
+#define _GNU_SOURCE
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <linux/io_uring.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/* linux/fs.h (pulled in by linux/io_uring.h) has its own block size macros */
+#undef BLOCK_SIZE_BITS
+#undef BLOCK_SIZE
+#include "block.h"
+#include "blockBackend.h"
+
+/* Asynchronous backend. block_submit queues reads and writes and hands them
+   to the kernel with a single io_uring_enter; block_complete waits for all
+   of them. When io_uring is not available (or BLOCK_ASYNC=threads is set)
+   the requests are carried out by a small pool of threads instead. The
+   synchronous block.h calls are a submit followed by a wait.
+
+   Requests on the same block are carried out in the order they were
+   submitted, within a batch and across batches: on io_uring such a
+   request is marked IOSQE_IO_DRAIN, and a pool thread never picks a
+   request whose block another thread is working on. */
+
+#define QUEUE_DEPTH 256
+#define POOL_THREADS 4
+
+static int fd = -1;
+static int completed = 0;
+
+/* Synchronous helpers, also used to finish short or unsupported requests */
+static void sync_read( int block, char *mem) {
+	off_t offset = (off_t) block * BLOCK_SIZE;
+	int done = 0;
+	ssize_t ret;
+
+	while ( done < BLOCK_SIZE) {
+		ret = pread( fd, mem + done, BLOCK_SIZE - done, offset + done);
+		assert( ret >= 0);
+		if ( ret == 0) { /* End of file */
+			memset( mem + done, 0, BLOCK_SIZE - done);
+			break;
+		}
+		done += ret;
+	}
+}
+
+static void sync_write( int block, char *mem) {
+	off_t offset = (off_t) block * BLOCK_SIZE;
+	int done = 0;
+	ssize_t ret;
+
+	while ( done < BLOCK_SIZE) {
+		ret = pwrite( fd, mem + done, BLOCK_SIZE - done, offset + done);
+		assert( ret > 0);
+		done += ret;
+	}
+}
+
+static void sync_io( int op, int block, char *mem) {
+	if ( op == BLOCK_OP_READ)
+		sync_read( block, mem);
+	else
+		sync_write( block, mem);
+}
+
+/*
+ * io_uring engine
+ */
+
+typedef struct {
+	int op;
+	int block;
+	char *mem;
+} async_req_t;
+
+static int ringFd = -1;
+static unsigned sqEntries;
+static unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+static unsigned *cqHead, *cqTail, *cqMask;
+static struct io_uring_sqe *sqes;
+static struct io_uring_cqe *cqes;
+static void *sqRing, *cqRing;
+static size_t sqRingSize, cqRingSize;
+
+/* Requests in flight, indexed by the sqe user_data */
+static async_req_t slots[QUEUE_DEPTH];
+static int freeSlots[QUEUE_DEPTH];
+static int numFreeSlots;
+static int inFlight = 0;
+
+/* Requests in flight per block hash, so that most blocks are known to be
+   free without looking at every slot */
+#define FLIGHT_HASH_SIZE 1024
+static int flightCount[FLIGHT_HASH_SIZE];
+
+static int uring_enter( unsigned toSubmit, unsigned minComplete) {
+	int ret;
+
+	do {
+		ret = syscall( __NR_io_uring_enter, ringFd, toSubmit, minComplete,
+			minComplete > 0 ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+	} while ( ret < 0 && errno == EINTR);
+
+	return ret;
+}
+
+static int uring_setup( void) {
+	struct io_uring_params p;
+	char *sq, *cq;
+	int i;
+
+	memset( &p, 0, sizeof(p));
+	ringFd = syscall( __NR_io_uring_setup, QUEUE_DEPTH, &p);
+	if ( ringFd < 0)
+		return 0;
+
+	sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if ( p.features & IORING_FEAT_SINGLE_MMAP) {
+		if ( cqRingSize > sqRingSize)
+			sqRingSize = cqRingSize;
+		cqRingSize = sqRingSize;
+	}
+
+	sqRing = mmap( NULL, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+		ringFd, IORING_OFF_SQ_RING);
+	if ( p.features & IORING_FEAT_SINGLE_MMAP)
+		cqRing = sqRing;
+	else
+		cqRing = mmap( NULL, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			ringFd, IORING_OFF_CQ_RING);
+	sqes = mmap( NULL, p.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+
+	if ( sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqes == MAP_FAILED) {
+		close( ringFd);
+		ringFd = -1;
+		return 0;
+	}
+
+	sq = sqRing;
+	cq = cqRing;
+	sqHead = (unsigned *) ( sq + p.sq_off.head);
+	sqTail = (unsigned *) ( sq + p.sq_off.tail);
+	sqMask = (unsigned *) ( sq + p.sq_off.ring_mask);
+	sqArray = (unsigned *) ( sq + p.sq_off.array);
+	cqHead = (unsigned *) ( cq + p.cq_off.head);
+	cqTail = (unsigned *) ( cq + p.cq_off.tail);
+	cqMask = (unsigned *) ( cq + p.cq_off.ring_mask);
+	cqes = (struct io_uring_cqe *) ( cq + p.cq_off.cqes);
+	sqEntries = p.sq_entries < QUEUE_DEPTH ? p.sq_entries : QUEUE_DEPTH;
+
+	numFreeSlots = sqEntries;
+	for ( i = 0; i < sqEntries; i++) {
+		freeSlots[i] = i;
+		slots[i].block = -1;
+	}
+	memset( flightCount, 0, sizeof(flightCount));
+
+	return 1;
+}
+
+static void uring_teardown( void) {
+	munmap( sqes, sqEntries * sizeof(struct io_uring_sqe));
+	if ( cqRing != sqRing)
+		munmap( cqRing, cqRingSize);
+	munmap( sqRing, sqRingSize);
+	close( ringFd);
+	ringFd = -1;
+}
+
+/* Consume every available completion */
+static void uring_reap( void) {
+	unsigned head = *cqHead;
+	unsigned tail = __atomic_load_n( cqTail, __ATOMIC_ACQUIRE);
+	struct io_uring_cqe *cqe;
+	async_req_t *req;
+
+	while ( head != tail) {
+		cqe = &cqes[head & *cqMask];
+		req = &slots[cqe->user_data];
+
+		/* A short read ends at the end of the file. Short writes and
+		   opcodes the kernel does not know are finished synchronously */
+		if ( cqe->res >= 0 && cqe->res < BLOCK_SIZE && req->op == BLOCK_OP_READ)
+			memset( req->mem + cqe->res, 0, BLOCK_SIZE - cqe->res);
+		else if ( cqe->res != BLOCK_SIZE) {
+			assert( cqe->res >= 0 || cqe->res == -EINVAL || cqe->res == -EOPNOTSUPP);
+			sync_io( req->op, req->block, req->mem);
+		}
+
+		flightCount[req->block & (FLIGHT_HASH_SIZE - 1)]--;
+		req->block = -1;
+		freeSlots[numFreeSlots++] = cqe->user_data;
+		inFlight--;
+		completed++;
+		head++;
+	}
+
+	__atomic_store_n( cqHead, head, __ATOMIC_RELEASE);
+}
+
+/* Take back the queued requests the kernel has not consumed and carry
+   them out synchronously */
+static void uring_withdraw( void) {
+	unsigned head, index;
+	async_req_t *req;
+	int slot;
+
+	/* The requests already submitted finish first, so that requests on
+	   one block keep their order */
+	while ( inFlight > 0 && uring_enter( 0, 1) >= 0)
+		uring_reap();
+
+	head = __atomic_load_n( sqHead, __ATOMIC_ACQUIRE);
+	for ( index = head; index != *sqTail; index++) {
+		slot = sqes[sqArray[index & *sqMask]].user_data;
+		req = &slots[slot];
+		sync_io( req->op, req->block, req->mem);
+
+		flightCount[req->block & (FLIGHT_HASH_SIZE - 1)]--;
+		req->block = -1;
+		freeSlots[numFreeSlots++] = slot;
+		completed++;
+	}
+
+	__atomic_store_n( sqTail, head, __ATOMIC_RELEASE);
+}
+
+/* Whether a request in flight (or queued) uses the block */
+static int uring_in_flight( int block) {
+	unsigned i;
+
+	if ( flightCount[block & (FLIGHT_HASH_SIZE - 1)] == 0)
+		return 0;
+
+	for ( i = 0; i < sqEntries; i++)
+		if ( slots[i].block == block)
+			return 1;
+
+	return 0;
+}
+
+static void uring_submit( int op, block_io_t *iov, int count) {
+	struct io_uring_sqe *sqe;
+	unsigned tail, index;
+	int queued, submitted, slot, drain, ret;
+
+	while ( count > 0) {
+		/* Wait for room in the ring */
+		if ( numFreeSlots == 0) {
+			ret = uring_enter( 0, 1);
+			assert( ret >= 0);
+			uring_reap();
+		}
+
+		tail = *sqTail;
+		for ( queued = 0; queued < count && numFreeSlots > 0; queued++) {
+			drain = uring_in_flight( iov[queued].block);
+			slot = freeSlots[--numFreeSlots];
+			slots[slot].op = op;
+			slots[slot].block = iov[queued].block;
+			flightCount[iov[queued].block & (FLIGHT_HASH_SIZE - 1)]++;
+			slots[slot].mem = iov[queued].mem;
+
+			index = tail & *sqMask;
+			sqe = &sqes[index];
+			memset( sqe, 0, sizeof(*sqe));
+			sqe->opcode = op == BLOCK_OP_READ ? IORING_OP_READ : IORING_OP_WRITE;
+			sqe->fd = fd;
+			sqe->off = (off_t) iov[queued].block * BLOCK_SIZE;
+			sqe->addr = (unsigned long) iov[queued].mem;
+			sqe->len = BLOCK_SIZE;
+			sqe->user_data = slot;
+			/* Wait for the earlier requests, which include the one on this block */
+			if ( drain)
+				sqe->flags |= IOSQE_IO_DRAIN;
+			sqArray[index] = index;
+			tail++;
+		}
+		__atomic_store_n( sqTail, tail, __ATOMIC_RELEASE);
+
+		/* One system call for the whole batch. The kernel may take only
+		   part of it; the rest stays in the ring for the next call */
+		for ( submitted = 0; submitted < queued; ) {
+			ret = uring_enter( queued - submitted, 0);
+			if ( ret > 0) {
+				submitted += ret;
+				inFlight += ret;
+			} else if ( ret < 0 && ( errno == EAGAIN || errno == EBUSY) && inFlight > 0) {
+				/* Out of resources: let requests in flight complete and retry */
+				if ( uring_enter( 0, 1) >= 0)
+					uring_reap();
+			} else {
+				/* No progress possible: finish the rest synchronously */
+				uring_withdraw();
+				break;
+			}
+		}
+
+		iov += queued;
+		count -= queued;
+	}
+}
+
+static void uring_drain( void) {
+	int ret;
+
+	while ( inFlight > 0) {
+		ret = uring_enter( 0, inFlight);
+		assert( ret >= 0);
+		uring_reap();
+	}
+}
+
+/*
+ * Thread pool fallback
+ */
+
+typedef struct job {
+	int op;
+	int block;
+	char *mem;
+	struct job *next;
+} job_t;
+
+static pthread_t workers[POOL_THREADS];
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t workReady = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t workDone = PTHREAD_COND_INITIALIZER;
+static job_t *queueHead = NULL, *queueTail = NULL;
+static int busyBlocks[POOL_THREADS];	/* block each thread is working on (-1: none) */
+static int outstanding = 0;
+static int stopping = 0;
+
+/* Take the first queued job whose block no thread is working on. Later
+   jobs on a busy block are skipped too, so they keep their order */
+static job_t *pool_take_job( void) {
+	job_t *job, *prev = NULL;
+	int i;
+
+	for ( job = queueHead; job != NULL; prev = job, job = job->next) {
+		for ( i = 0; i < POOL_THREADS && busyBlocks[i] != job->block; i++)
+			;
+		if ( i < POOL_THREADS)
+			continue;
+
+		if ( prev != NULL)
+			prev->next = job->next;
+		else
+			queueHead = job->next;
+		if ( queueTail == job)
+			queueTail = prev;
+
+		return job;
+	}
+
+	return NULL;
+}
+
+static void *pool_worker( void *arg) {
+	int id = (int) (long) arg;
+	job_t *job;
+
+	pthread_mutex_lock( &lock);
+	while ( 1) {
+		while ( ( job = pool_take_job()) == NULL && !stopping)
+			pthread_cond_wait( &workReady, &lock);
+		if ( job == NULL)
+			break;
+
+		busyBlocks[id] = job->block;
+		pthread_mutex_unlock( &lock);
+		sync_io( job->op, job->block, job->mem);
+		free( job);
+		pthread_mutex_lock( &lock);
+		busyBlocks[id] = -1;
+
+		outstanding--;
+		completed++;
+		/* Jobs held back for this block may run now */
+		if ( queueHead != NULL)
+			pthread_cond_broadcast( &workReady);
+		if ( outstanding == 0)
+			pthread_cond_broadcast( &workDone);
+	}
+	pthread_mutex_unlock( &lock);
+
+	return NULL;
+}
+
+static void pool_setup( void) {
+	int i;
+
+	stopping = 0;
+	for ( i = 0; i < POOL_THREADS; i++) {
+		busyBlocks[i] = -1;
+		pthread_create( &workers[i], NULL, pool_worker, (void *) (long) i);
+	}
+}
+
+static void pool_teardown( void) {
+	int i;
+
+	pthread_mutex_lock( &lock);
+	stopping = 1;
+	pthread_cond_broadcast( &workReady);
+	pthread_mutex_unlock( &lock);
+
+	for ( i = 0; i < POOL_THREADS; i++)
+		pthread_join( workers[i], NULL);
+}
+
+static void pool_submit( int op, block_io_t *iov, int count) {
+	job_t *job;
+	int i;
+
+	pthread_mutex_lock( &lock);
+	for ( i = 0; i < count; i++) {
+		job = malloc( sizeof(job_t));
+		job->op = op;
+		job->block = iov[i].block;
+		job->mem = iov[i].mem;
+		job->next = NULL;
+
+		if ( queueTail != NULL)
+			queueTail->next = job;
+		else
+			queueHead = job;
+		queueTail = job;
+	}
+	outstanding += count;
+	pthread_cond_broadcast( &workReady);
+	pthread_mutex_unlock( &lock);
+}
+
+static void pool_drain( void) {
+	pthread_mutex_lock( &lock);
+	while ( outstanding > 0)
+		pthread_cond_wait( &workDone, &lock);
+	pthread_mutex_unlock( &lock);
+}
+
+/*
+ * Backend operations
+ */
+
+static void async_submit( int op, block_io_t *iov, int count) {
+	if ( ringFd >= 0)
+		uring_submit( op, iov, count);
+	else
+		pool_submit( op, iov, count);
+}
+
+/* Wait until every submitted request is done */
+static void async_drain( void) {
+	if ( ringFd >= 0)
+		uring_drain();
+	else
+		pool_drain();
+}
+
+static int async_complete( void) {
+	int ret;
+
+	async_drain();
+
+	pthread_mutex_lock( &lock);
+	ret = completed;
+	completed = 0;
+	pthread_mutex_unlock( &lock);
+
+	return ret;
+}
+
+static void async_init( void) {
+	char *mode = getenv( "BLOCK_ASYNC");
+
+	fd = open( "./disk", O_RDWR | O_CREAT, 0644);
+	assert( fd >= 0);
+
+	completed = 0;
+	if ( mode != NULL && strcmp( mode, "threads") == 0)
+		pool_setup();
+	else if ( !uring_setup())
+		pool_setup();
+}
+
+static void async_close( void) {
+	async_drain();
+
+	if ( ringFd >= 0)
+		uring_teardown();
+	else
+		pool_teardown();
+
+	close( fd);
+	fd = -1;
+}
+
+static void async_readv( block_io_t *iov, int count) {
+	async_submit( BLOCK_OP_READ, iov, count);
+	async_drain();
+}
+
+static void async_writev( block_io_t *iov, int count) {
+	async_submit( BLOCK_OP_WRITE, iov, count);
+	async_drain();
+}
+
+static void async_read( int block, char *mem) {
+	block_io_t io = { block, mem };
+
+	async_readv( &io, 1);
+}
+
+static void async_write( int block, char *mem) {
+	block_io_t io = { block, mem };
+
+	async_writev( &io, 1);
+}
+
+static void async_sync( void) {
+	async_drain();
+	fdatasync( fd);
+}
+
+static void async_truncate( void) {
+	int ret;
+
+	async_drain();
+	ret = ftruncate( fd, 0);
+	assert( ret == 0);
+}
+
+block_backend_t async_backend = {
+	async_init, async_close, async_read, async_write, async_readv, async_writev, async_sync,
+	async_truncate, async_submit, async_complete
+};
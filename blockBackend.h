@@ -0,0 +1,23 @@
+#ifndef BLOCK_BACKEND_INCLUDED
+#define BLOCK_BACKEND_INCLUDED
+
+/* Operations every block.h backend provides */
+typedef struct {
+	void (*init)( void);
+	void (*close)( void);
+	void (*read)( int block, char *mem);
+	void (*write)( int block, char *mem);
+	void (*readv)( block_io_t *iov, int count);	/* NULL: one read per block */
+	void (*writev)( block_io_t *iov, int count);	/* NULL: one write per block */
+	void (*sync)( void);
+	void (*truncate)( void);
+	void (*submit)( int op, block_io_t *iov, int count);	/* NULL: synchronous */
+	int (*complete)( void);
+} block_backend_t;
+
+extern block_backend_t stdio_backend;
+extern block_backend_t pio_backend;
+extern block_backend_t mmap_backend;
+extern block_backend_t async_backend;
+
+#endif
@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include "block.h"
+
+/* Measures block_read/block_write throughput (blocks/sec) for each block.h
+   backend, using blocks of 2^argv[1] bytes (512 by default). Runs inside a temporary directory so ./disk is left untouched. */
+
+#define BENCH_BLOCKS 2048
+#define BENCH_ROUNDS 4
+
+static char *names[] = { "stdio", "pio", "mmap", "async" };
+static int backends[] = { BLOCK_BACKEND_STDIO, BLOCK_BACKEND_PIO, BLOCK_BACKEND_MMAP, BLOCK_BACKEND_ASYNC };
+
+static double now( void) {
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report( char *backend, char *test, int blocks, double elapsed) {
+	printf( "%-8s %-12s %10.0f blocks/sec\n", backend, test, blocks / elapsed);
+}
+
+int main( int argc, char **argv) {
+	char template[] = "/tmp/blockbenchXXXXXX";
+	char mem[BLOCK_SIZE];
+	block_io_t *batch;
+	int *order;
+	int b, i, r;
+	double start;
+
+	/* Optional argument: log2 of the block size */
+	if ( argc > 1)
+		block_set_size( atoi( argv[1]));
+
+	if ( mkdtemp( template) == NULL || chdir( template) != 0) {
+		perror( "blockbench");
+		return 1;
+	}
+
+	/* Random permutation of the blocks, shared by all backends */
+	order = malloc( BENCH_BLOCKS * sizeof(int));
+	for ( i = 0; i < BENCH_BLOCKS; i++)
+		order[i] = i;
+	srand( 42);
+	for ( i = BENCH_BLOCKS - 1; i > 0; i--) {
+		int j = rand() % ( i + 1), t = order[i];
+		order[i] = order[j];
+		order[j] = t;
+	}
+
+	for ( i = 0; i < BLOCK_SIZE; i++)
+		mem[i] = i;
+
+	/* One request per block, all submitted at once */
+	batch = malloc( BENCH_BLOCKS * sizeof(block_io_t));
+	for ( i = 0; i < BENCH_BLOCKS; i++) {
+		batch[i].block = order[i];
+		batch[i].mem = malloc( BLOCK_SIZE);
+	}
+
+	for ( b = 0; b < sizeof(backends) / sizeof(int); b++) {
+		unlink( "./disk");
+		block_init_backend( backends[b]);
+
+		start = now();
+		for ( r = 0; r < BENCH_ROUNDS; r++)
+			for ( i = 0; i < BENCH_BLOCKS; i++)
+				block_write( i, mem);
+		block_sync();
+		report( names[b], "seq write", BENCH_ROUNDS * BENCH_BLOCKS, now() - start);
+
+		start = now();
+		for ( r = 0; r < BENCH_ROUNDS; r++)
+			for ( i = 0; i < BENCH_BLOCKS; i++)
+				block_write( order[i], mem);
+		block_sync();
+		report( names[b], "rand write", BENCH_ROUNDS * BENCH_BLOCKS, now() - start);
+
+		start = now();
+		for ( r = 0; r < BENCH_ROUNDS; r++)
+			for ( i = 0; i < BENCH_BLOCKS; i++)
+				block_read( i, mem);
+		report( names[b], "seq read", BENCH_ROUNDS * BENCH_BLOCKS, now() - start);
+
+		start = now();
+		for ( r = 0; r < BENCH_ROUNDS; r++)
+			for ( i = 0; i < BENCH_BLOCKS; i++)
+				block_read( order[i], mem);
+		report( names[b], "rand read", BENCH_ROUNDS * BENCH_BLOCKS, now() - start);
+
+		start = now();
+		for ( r = 0; r < BENCH_ROUNDS; r++) {
+			block_submit( BLOCK_OP_WRITE, batch, BENCH_BLOCKS);
+			block_complete();
+		}
+		block_sync();
+		report( names[b], "batch write", BENCH_ROUNDS * BENCH_BLOCKS, now() - start);
+
+		start = now();
+		for ( r = 0; r < BENCH_ROUNDS; r++) {
+			block_submit( BLOCK_OP_READ, batch, BENCH_BLOCKS);
+			block_complete();
+		}
+		report( names[b], "batch read", BENCH_ROUNDS * BENCH_BLOCKS, now() - start);
+	}
+
+	unlink( "./disk");
+	chdir( "/");
+	rmdir( template);
+	for ( i = 0; i < BENCH_BLOCKS; i++)
+		free( batch[i].mem);
+	free( batch);
+	free( order);
+
+	return 0;
+}
@@ -1,13 +1,24 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
 #include <assert.h>
 #include "common.h"
 #include "block.h"
+#include "blockBackend.h"
 
 static FILE *fd;
 
 #include <errno.h>
 
-void block_init( void) {
+static block_backend_t *backend = NULL;
+
+int block_size_bits = DEFAULT_BLOCK_SIZE_BITS;
+
+/* Requests already carried out by block_submit on synchronous backends */
+static int completed = 0;
+
+static void stdio_init( void) {
 	int ret;
 
 	fd = fopen( "./disk", "r+");
@@ -19,10 +30,15 @@ void block_init( void) {
 	assert( ret == 0);
 }
 
-void block_read( int block, char *mem) {
+static void stdio_close( void) {
+	fclose( fd);
+	fd = NULL;
+}
+
+static void stdio_read( int block, char *mem) {
 	int ret;
 
-	ret = fseek( fd, block * BLOCK_SIZE, SEEK_SET);
+	ret = fseeko( fd, (off_t) block * BLOCK_SIZE, SEEK_SET);
 	assert( ret == 0);
     
 	ret = fread( mem, 1, BLOCK_SIZE, fd);
@@ -33,10 +49,10 @@ void block_read( int block, char *mem) {
 	assert( ret == BLOCK_SIZE);
 }
 
-void block_write( int block, char *mem) {
+static void stdio_write( int block, char *mem) {
 	int ret;
     
-	ret = fseek( fd, block * BLOCK_SIZE, SEEK_SET);
+	ret = fseeko( fd, (off_t) block * BLOCK_SIZE, SEEK_SET);
 	assert( ret == 0);
     
 	ret = fwrite( mem, 1, BLOCK_SIZE, fd);
@@ -45,6 +61,130 @@ void block_write( int block, char *mem) {
 	fflush(fd);
 }
 
+static void stdio_sync( void) {
+	fflush( fd);
+}
+
+static void stdio_truncate( void) {
+	int ret;
+
+	fflush( fd);
+	ret = ftruncate( fileno( fd), 0);
+	assert( ret == 0);
+}
+
+block_backend_t stdio_backend = {
+	stdio_init, stdio_close, stdio_read, stdio_write, NULL, NULL, stdio_sync,
+	stdio_truncate, NULL, NULL
+};
+
+void block_init( void) {
+	int type = BLOCK_DEFAULT_BACKEND;
+	char *name = getenv( "BLOCK_BACKEND");
+
+	if ( name != NULL && strcmp( name, "stdio") == 0)
+		type = BLOCK_BACKEND_STDIO;
+	else if ( name != NULL && strcmp( name, "pio") == 0)
+		type = BLOCK_BACKEND_PIO;
+	else if ( name != NULL && strcmp( name, "mmap") == 0)
+		type = BLOCK_BACKEND_MMAP;
+	else if ( name != NULL && strcmp( name, "async") == 0)
+		type = BLOCK_BACKEND_ASYNC;
+
+	block_init_backend( type);
+}
+
+void block_init_backend( int type) {
+	if ( backend != NULL)
+		backend->close();
+
+	switch ( type) {
+	case BLOCK_BACKEND_PIO:
+		backend = &pio_backend;
+		break;
+	case BLOCK_BACKEND_MMAP:
+		backend = &mmap_backend;
+		break;
+	case BLOCK_BACKEND_ASYNC:
+		backend = &async_backend;
+		break;
+	default:
+		backend = &stdio_backend;
+		break;
+	}
+
+	backend->init();
+}
+
+void block_set_size( int bits) {
+	assert( bits >= MIN_BLOCK_SIZE_BITS && bits <= MAX_BLOCK_SIZE_BITS);
+	block_size_bits = bits;
+}
+
+void block_read( int block, char *mem) {
+	backend->read( block, mem);
+}
+
+void block_write( int block, char *mem) {
+	backend->write( block, mem);
+}
+
+void block_readv( block_io_t *iov, int count) {
+	int i;
+
+	if ( backend->readv != NULL) {
+		backend->readv( iov, count);
+		return;
+	}
+
+	for ( i = 0; i < count; i++)
+		backend->read( iov[i].block, iov[i].mem);
+}
+
+void block_writev( block_io_t *iov, int count) {
+	int i;
+
+	if ( backend->writev != NULL) {
+		backend->writev( iov, count);
+		return;
+	}
+
+	for ( i = 0; i < count; i++)
+		backend->write( iov[i].block, iov[i].mem);
+}
+
+void block_submit( int op, block_io_t *iov, int count) {
+	if ( backend->submit != NULL) {
+		backend->submit( op, iov, count);
+		return;
+	}
+
+	if ( op == BLOCK_OP_READ)
+		block_readv( iov, count);
+	else
+		block_writev( iov, count);
+	completed += count;
+}
+
+int block_complete( void) {
+	int ret;
+
+	if ( backend->complete != NULL)
+		return backend->complete();
+
+	ret = completed;
+	completed = 0;
+	return ret;
+}
+
+void block_sync( void) {
+	backend->sync();
+}
+
+void block_truncate( void) {
+	backend->truncate();
+}
+
 void bzero_block( char *block) {
 	int i;
 
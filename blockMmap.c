@@ -0,0 +1,109 @@
+#define _GNU_SOURCE
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <assert.h>
+#include "block.h"
+#include "blockBackend.h"
+
+/* Backend that maps the whole disk image into memory. Reads and writes are
+   plain copies from/to the mapping; msync on block_sync makes them durable.
+
+   The mapping is created once at init and covers MMAP_RESERVE bytes of
+   address space (at least the FS_SIZE blocks of the default device), far
+   more than the image. Pages past the end of the file are never touched:
+   writing a block past the end grows the file to exactly the end of that
+   block, as the other backends do, without remapping. Only an image larger
+   than the reservation makes the mapping move. */
+
+/* Address space reserved for the mapping */
+#define MMAP_RESERVE ((size_t) 1 << 40)
+
+static int fd = -1;
+static char *map = NULL;
+static size_t mapSize = 0;	/* length of the mapping */
+static size_t fileSize = 0;	/* length of the image file; blocks past it read as zeros */
+
+static void mmap_grow( size_t size) {
+	int ret;
+
+	ret = ftruncate( fd, size);
+	assert( ret == 0);
+	fileSize = size;
+
+	if ( size > mapSize) {
+		map = mremap( map, mapSize, size, MREMAP_MAYMOVE);
+		assert( map != MAP_FAILED);
+		mapSize = size;
+	}
+}
+
+static void mmap_init( void) {
+	struct stat st;
+
+	fd = open( "./disk", O_RDWR | O_CREAT, 0644);
+	assert( fd >= 0);
+
+	fstat( fd, &st);
+	fileSize = st.st_size;
+
+	/* Reserve room to grow in place; fall back to the device size if the reservation is refused */
+	mapSize = fileSize > MMAP_RESERVE ? fileSize : MMAP_RESERVE;
+	map = mmap( NULL, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_NORESERVE, fd, 0);
+	if ( map == MAP_FAILED) {
+		mapSize = fileSize > (size_t) FS_SIZE * BLOCK_SIZE ? fileSize : (size_t) FS_SIZE * BLOCK_SIZE;
+		map = mmap( NULL, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	}
+	assert( map != MAP_FAILED);
+}
+
+static void mmap_close( void) {
+	munmap( map, mapSize);
+	close( fd);
+	map = NULL;
+	mapSize = 0;
+	fileSize = 0;
+	fd = -1;
+}
+
+static void mmap_read( int block, char *mem) {
+	size_t offset = (size_t) block * BLOCK_SIZE;
+
+	size_t length = BLOCK_SIZE;
+
+	if ( offset + BLOCK_SIZE > fileSize) { /* End of file: a partial last block keeps its bytes */
+		length = offset < fileSize ? fileSize - offset : 0;
+		memset( mem + length, 0, BLOCK_SIZE - length);
+	}
+
+	memcpy( mem, map + offset, length);
+}
+
+static void mmap_write( int block, char *mem) {
+	size_t offset = (size_t) block * BLOCK_SIZE;
+
+	if ( offset + BLOCK_SIZE > fileSize)
+		mmap_grow( offset + BLOCK_SIZE);
+
+	memcpy( map + offset, mem, BLOCK_SIZE);
+}
+
+static void mmap_sync( void) {
+	msync( map, fileSize, MS_SYNC);
+}
+
+static void mmap_truncate( void) {
+	int ret;
+
+	/* Drop the contents; the mapping itself does not change */
+	ret = ftruncate( fd, 0);
+	assert( ret == 0);
+	fileSize = 0;
+}
+
+block_backend_t mmap_backend = {
+	mmap_init, mmap_close, mmap_read, mmap_write, NULL, NULL, mmap_sync,
+	mmap_truncate, NULL, NULL
+};
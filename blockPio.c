@@ -0,0 +1,127 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <assert.h>
+#include "block.h"
+#include "blockBackend.h"
+
+/* Backend that accesses the disk image through a raw file descriptor with
+   positional reads and writes. Writes are not flushed individually; data
+   only reaches stable storage when block_sync is called. */
+
+/* Largest number of blocks merged into a single preadv/pwritev */
+#define MAX_RUN 256
+
+static int fd = -1;
+
+static void pio_init( void) {
+	fd = open( "./disk", O_RDWR | O_CREAT, 0644);
+	assert( fd >= 0);
+}
+
+static void pio_close( void) {
+	close( fd);
+	fd = -1;
+}
+
+static void pio_read( int block, char *mem) {
+	off_t offset = (off_t) block * BLOCK_SIZE;
+	int done = 0;
+	ssize_t ret;
+
+	while ( done < BLOCK_SIZE) {
+		ret = pread( fd, mem + done, BLOCK_SIZE - done, offset + done);
+		assert( ret >= 0);
+		if ( ret == 0) { /* End of file */
+			while ( done < BLOCK_SIZE)
+				mem[done++] = 0;
+			break;
+		}
+		done += ret;
+	}
+}
+
+static void pio_write( int block, char *mem) {
+	off_t offset = (off_t) block * BLOCK_SIZE;
+	int done = 0;
+	ssize_t ret;
+
+	while ( done < BLOCK_SIZE) {
+		ret = pwrite( fd, mem + done, BLOCK_SIZE - done, offset + done);
+		assert( ret > 0);
+		done += ret;
+	}
+}
+
+/* Length of the run of physically adjacent blocks starting at iov[0] */
+static int run_length( block_io_t *iov, int count) {
+	int n = 1;
+
+	while ( n < count && n < MAX_RUN && iov[n].block == iov[0].block + n)
+		n++;
+
+	return n;
+}
+
+static void pio_readv( block_io_t *iov, int count) {
+	struct iovec vec[MAX_RUN];
+	ssize_t ret;
+	int i, n;
+
+	while ( count > 0) {
+		n = run_length( iov, count);
+
+		for ( i = 0; i < n; i++) {
+			vec[i].iov_base = iov[i].mem;
+			vec[i].iov_len = BLOCK_SIZE;
+		}
+
+		/* A short transfer (end of file or signal) is finished block by block */
+		ret = preadv( fd, vec, n, (off_t) iov[0].block * BLOCK_SIZE);
+		assert( ret >= 0);
+		for ( i = ret / BLOCK_SIZE; i < n; i++)
+			pio_read( iov[i].block, iov[i].mem);
+
+		iov += n;
+		count -= n;
+	}
+}
+
+static void pio_writev( block_io_t *iov, int count) {
+	struct iovec vec[MAX_RUN];
+	ssize_t ret;
+	int i, n;
+
+	while ( count > 0) {
+		n = run_length( iov, count);
+
+		for ( i = 0; i < n; i++) {
+			vec[i].iov_base = iov[i].mem;
+			vec[i].iov_len = BLOCK_SIZE;
+		}
+
+		ret = pwritev( fd, vec, n, (off_t) iov[0].block * BLOCK_SIZE);
+		assert( ret >= 0);
+		for ( i = ret / BLOCK_SIZE; i < n; i++)
+			pio_write( iov[i].block, iov[i].mem);
+
+		iov += n;
+		count -= n;
+	}
+}
+
+static void pio_sync( void) {
+	fdatasync( fd);
+}
+
+static void pio_truncate( void) {
+	int ret;
+
+	ret = ftruncate( fd, 0);
+	assert( ret == 0);
+}
+
+block_backend_t pio_backend = {
+	pio_init, pio_close, pio_read, pio_write, pio_readv, pio_writev, pio_sync,
+	pio_truncate, NULL, NULL
+};
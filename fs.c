@@ -1,9 +1,12 @@
 #include <stdlib.h>
 #include <math.h>
 #include <stdarg.h>
+#include <limits.h>
 #include "util.h"
 #include "common.h"
 #include "block.h"
+#include "bcache.h"
+#include "bitops.h"
 #include "fs.h"
 
 #ifdef FAKE
@@ -17,6 +20,7 @@
 Superblock* superblock;
 Inode* inodes;
 File** fdTable;
+DirStream* dirTable[DIR_TABLE_SIZE];
 char* buffer;
 int numFileDescriptors;
 int unlink_addarg_count = 0;
@@ -25,11 +29,24 @@ int unlink_addarg_count = 0;
 char dirEntry1[MAX_FILE_NAME] = ".";
 char dirEntry2[MAX_FILE_NAME] = "..";
 
+#ifdef FAKE
+static void fs_exit(void) {
+    fs_sync();
+}
+#endif
+
 /* Inclui funções adicionais que criamos para uma melhor organização do código */
+#include "fs_icache.c"
+#include "fs_bitmap.c"
+#include "fs_bmap.c"
+#include "fs_dirent.c"
+#include "fs_dirindex.c"
+#include "fs_dcache.c"
 #include "fs_functions.c"
 
 void fs_init(void) {
     block_init();
+    bcache_init();
 
     /* Aloca memória para a variável buffer */
     buffer = (char*) malloc(BLOCK_SIZE * sizeof(char));
@@ -37,7 +54,7 @@ void fs_init(void) {
     /* Zera todos os bytes da variável buffer */
     bzero(buffer, BLOCK_SIZE);
     /* Lê o primeiro bloco do disco (superbloco) e armazena na variável buffer */
-    block_read(SUPERBLOCK_BLOCK_NUMBER, buffer);
+    bcache_read(SUPERBLOCK_BLOCK_NUMBER, buffer);
 
     /* Inicializa a estrutura superblock */
     superblock = (Superblock*) malloc(sizeof(Superblock));
@@ -52,28 +69,148 @@ void fs_init(void) {
         /* Invoca a função responsável por formatar o disco */
         fs_mkfs();
     } else {
+        /* Discos anteriores aos ponteiros indiretos duplos e triplos (que também não têm o campo iMapBlocks) usam 10 ponteiros diretos */
+        int legacyPointers = superblock->pointerLayout != POINTER_LAYOUT_INDIRECT3 && superblock->iMapBlocks == 0 && superblock->inodeFormat == INODE_FORMAT_POINTERS;
+
+        /* Discos formatados antes do campo existir usam blocos de 512 bytes */
+        if(superblock->blockSizeBits == 0)
+            superblock->blockSizeBits = DEFAULT_BLOCK_SIZE_BITS;
+
+        /* E mapas de bits de um único bloco */
+        if(superblock->iMapBlocks == 0)
+            superblock->iMapBlocks = 1;
+
+        if(superblock->dMapBlocks == 0)
+            superblock->dMapBlocks = 1;
+
+        /* E, portanto, um único grupo */
+        if(superblock->blocksPerGroup == 0) {
+            superblock->blocksPerGroup = 8 << superblock->blockSizeBits;
+            superblock->inodesPerGroup = superblock->numberOfInodes;
+        }
+
+        /* Passa a usar o tamanho de bloco com que o disco foi formatado */
+        if(superblock->blockSizeBits != BLOCK_SIZE_BITS) {
+            block_set_size(superblock->blockSizeBits);
+            bcache_init();
+        }
+
+        /* Carrega os mapas de bits, que passam a ficar residentes em memória */
+        load_bitmaps();
+
+        /* Converte os inodes antigos antes de qualquer acesso aos blocos dos arquivos; sem espaço, o disco não é montado */
+        if(legacyPointers && convert_pointer_layout() != 0) {
+            ERROR_MSG(("Disco com inodes de 10 ponteiros diretos sem blocos livres para convertê-los\n"))
+            exit(EXIT_FAILURE);
+        }
+
+        superblock->pointerLayout = POINTER_LAYOUT_INDIRECT3;
+
+        /* Discos formatados com entradas de tamanho fixo têm os diretórios convertidos para registros */
+        if(superblock->dirFormat != DIR_FORMAT_RECORDS && convert_directories() != 0) {
+            ERROR_MSG(("Disco com diretórios de entradas fixas sem blocos livres para convertê-los\n"))
+            exit(EXIT_FAILURE);
+        }
+
         /* Cria tabela de descritores de arquivo em memória */
         fdTable = init_fd_table();
         numFileDescriptors = 0;
     }
+
+#ifdef FAKE
+    /* Garante que os blocos sujos da cache sejam escritos no disco ao encerrar o programa; registrado só depois da
+       montagem, para que um disco recusado acima não receba as conversões feitas pela metade em memória */
+    atexit(fs_exit);
+#endif
 }
 
 int fs_mkfs(void) {
-    /* Limpa conteúdo do arquivo disk */
-    FILE* file = fopen("disk", "w");
-    fclose(file);
+    /* Formata o disco com as opções padrão */
+    MkfsOptions options;
+    options.blockSize = 1 << DEFAULT_BLOCK_SIZE_BITS;
+    options.inodeFormat = INODE_FORMAT_POINTERS;
+    options.numBlocks = FS_SIZE;
+    options.bytesPerInode = 0;
+    options.blocksPerGroup = 0;
+    options.fdTableSize = 0;
+
+    return fs_mkfs_with(&options);
+}
+
+int fs_mkfs_with(MkfsOptions* options) {
+    /* Calcula log2 do tamanho do bloco e verifica se é um tamanho suportado */
+    int blockSizeBits = MIN_BLOCK_SIZE_BITS;
+
+    while(blockSizeBits < MAX_BLOCK_SIZE_BITS && (1 << blockSizeBits) != options->blockSize)
+        blockSizeBits++;
+
+    if((1 << blockSizeBits) != options->blockSize)
+        return -1;
+
+    if(options->inodeFormat != INODE_FORMAT_POINTERS && options->inodeFormat != INODE_FORMAT_EXTENTS)
+        return -1;
+
+    /* Calcula a geometria: quantidade de inodes e blocos ocupados pelos mapas de bits e pela tabela de inodes */
+    int numBlocks = options->numBlocks > 0 ? options->numBlocks : FS_SIZE;
+    long long inodeCount = DEFAULT_NUMBER_OF_INODES;
+
+    if(options->bytesPerInode > 0)
+        inodeCount = ((long long) numBlocks << blockSizeBits) / options->bytesPerInode;
+
+    /* Números de inode e de bloco são int: recusa geometrias que não cabem neles */
+    if(inodeCount > INT_MAX)
+        return -1;
+
+    int numInodes = (int) inodeCount;
+
+    int bitsPerBlock = 8 << blockSizeBits;
+    int iMapBlocks = (numInodes + bitsPerBlock - 1) / bitsPerBlock;
+    int inodeBlocks = (int) (((long long) numInodes * sizeof(Inode) + (1 << blockSizeBits) - 1) >> blockSizeBits);
+    int remaining = numBlocks - 1 - iMapBlocks - inodeBlocks;
+    int dMapBlocks = (remaining + bitsPerBlock - 1) / bitsPerBlock;
+
+    /* Verifica se sobra espaço para os inodes e para os blocos de dados */
+    if(numInodes < 1 || remaining - dMapBlocks < 1 || options->blocksPerGroup < 0 || options->fdTableSize < 0)
+        return -1;
+
+    /* Divide os blocos de dados em grupos (por padrão, os bits de um bloco do mapa) começando em bytes inteiros dos mapas, e os inodes igualmente entre eles */
+    int blocksPerGroup = options->blocksPerGroup > 0 ? (options->blocksPerGroup + 7) & ~7 : bitsPerBlock;
+    int numGroups = (remaining - dMapBlocks + blocksPerGroup - 1) / blocksPerGroup;
+    int inodesPerGroup = (int) ((((long long) numInodes + numGroups - 1) / numGroups + 7) & ~7);
+
+    /* Descarta os inodes e blocos em cache, pois o disco será formatado */
+    invalidate_inodes();
+    invalidate_dentries();
+    invalidate_dir_streams();
+    invalidate_indirect_cache();
+    bcache_invalidate();
+
+    /* Limpa conteúdo do disco */
+    block_truncate();
+
+    /* Passa a usar o novo tamanho de bloco no dispositivo e na cache */
+    block_set_size(blockSizeBits);
+    bcache_init();
 
     /* Inicializa as informações do superbloco */
     bcopy((unsigned char*) MAGIC_NUMBER, (unsigned char*) superblock->magicNumber, 5);
-    superblock->diskSize = FS_SIZE;
-    superblock->numberOfInodes = 512;
+    superblock->blockSizeBits = blockSizeBits;
+    superblock->inodeFormat = options->inodeFormat;
+    superblock->diskSize = numBlocks;
+    superblock->numberOfInodes = numInodes;
     superblock->workingDirectory = 0;
     superblock->iMapStart = 1;
-    superblock->dMapStart = 2;
-    superblock->inodeStart = 3;
-    superblock->dataBlockStart = superblock->inodeStart + (int) ceil((double) (superblock->numberOfInodes * sizeof(Inode)) / BLOCK_SIZE);
-    superblock->numberOfDataBlocks = FS_SIZE - superblock->dataBlockStart;
-    superblock->fdTableSize = 256;
+    superblock->iMapBlocks = iMapBlocks;
+    superblock->dMapStart = superblock->iMapStart + iMapBlocks;
+    superblock->dMapBlocks = dMapBlocks;
+    superblock->inodeStart = superblock->dMapStart + dMapBlocks;
+    superblock->dataBlockStart = superblock->inodeStart + inodeBlocks;
+    superblock->numberOfDataBlocks = numBlocks - superblock->dataBlockStart;
+    superblock->fdTableSize = options->fdTableSize > 0 ? options->fdTableSize : FD_TABLE_DEFAULT_SIZE;
+    superblock->blocksPerGroup = blocksPerGroup;
+    superblock->inodesPerGroup = inodesPerGroup;
+    superblock->dirFormat = DIR_FORMAT_RECORDS;
+    superblock->pointerLayout = POINTER_LAYOUT_INDIRECT3;
 
     /* Aloca memória para a variável buffer */
     buffer = (char*) malloc(BLOCK_SIZE * sizeof(char));
@@ -81,50 +218,24 @@ int fs_mkfs(void) {
     /* Zera os bytes do buffer, copia os bytes da estrutura superblock para o buffer e escreve o conteúdo no primeiro bloco (superblock) do disco */
     bzero(buffer, BLOCK_SIZE);
     bcopy((unsigned char*) superblock, (unsigned char*) buffer, sizeof(Superblock));
-    block_write(SUPERBLOCK_BLOCK_NUMBER, buffer);
-
-    /* Escreve bytes 0s nos blocos alocados para armazenar inodes */
-    int bufferSize = BLOCK_SIZE * (int) ceil((double) (NUMBER_OF_INODES * sizeof(Inode)) / BLOCK_SIZE);
-    buffer = realloc(buffer, bufferSize);
-    bzero(buffer, bufferSize);
+    bcache_write(SUPERBLOCK_BLOCK_NUMBER, buffer);
 
-    /* Calcula quantos blocos são necessários para alocar a quantidade de inodes projetada */
-    int numInodeBlocks = bufferSize / BLOCK_SIZE;
+    /* A tabela de inodes não precisa ser zerada: o disco truncado já lê blocos zerados, mesmo em imagens grandes */
 
-    /* Escreve os bytes 0s nos blocos alocados para guardar inodes */
-    for(int i = 0; i < numInodeBlocks; i++) {
-        block_write(i + INODE_START, &buffer[i * BLOCK_SIZE]);
-    }
+    /* Inicializa os mapas de bits marcando como ocupado o primeiro inode (diretório raiz) */
+    format_bitmaps();
 
-    /* Cria o primeiro inode como sendo o inode correspondente ao diretório raiz */
+    /* Cria o primeiro inode como sendo o inode correspondente ao diretório raiz, com o primeiro bloco de dados */
     Inode* inode = create_new_inode();
     inode->type = DIRECTORY;
-    inode->size = 2 * sizeof(DirectoryItem);
-    inode->direct[0] = DATA_BLOCK_START;
+    bmap_alloc(inode, ROOT_DIRECTORY_INODE, 0, 0);
+    inode_set_data_size(inode, BLOCK_SIZE);
     save_inode(inode, ROOT_DIRECTORY_INODE);
 
-    /* Inicializa um vetor de diretórios e insere as entradas '.' e '..' inicialmente como entradas do diretório raiz */
-    DirectoryItem* rootDirectory = (DirectoryItem*) malloc(2 * sizeof(DirectoryItem));
-    bcopy((unsigned char*) dirEntry1, (unsigned char*) rootDirectory[0].name, MAX_FILE_NAME);
-    rootDirectory[0].inode = 0;
-    bcopy((unsigned char*) dirEntry2, (unsigned char*) rootDirectory[1].name, MAX_FILE_NAME);
-    rootDirectory[1].inode = 0;
-
-    /* Escreve no primeiro bloco de dados o diretório raiz */
+    /* Escreve no primeiro bloco de dados o diretório raiz, com as entradas '.' e '..' apontando para ele mesmo */
     buffer = realloc(buffer, BLOCK_SIZE);
-    bzero(buffer, BLOCK_SIZE);
-    bcopy((unsigned char*) rootDirectory, (unsigned char*) buffer, 2 * sizeof(DirectoryItem));
-    block_write(DATA_BLOCK_START, buffer);
-
-    /* Zera os bytes da variável buffer, seta o bit correspondende ao primeiro inode para 1 (ocupado - diretório raiz) e escreve o buffer no bloco onde fica o mapa de bits dos inodes */
-    bzero(buffer, BLOCK_SIZE);
-    set_bit(buffer, 0, 7);
-    save_bitmap(buffer, I_MAP_BLOCK);
-
-    /* Zera os bytes da variável buffer, seta o bit correspondende ao primeiro bloco de dados para 1 (ocupado - diretório raiz) e escreve o buffer no bloco onde fica o mapa de bits dos blocos de dados */
-    bzero(buffer, BLOCK_SIZE);
-    set_bit(buffer, 0, 7);
-    save_bitmap(buffer, D_MAP_BLOCK);
+    dir_block_init_empty(buffer, 0, 0);
+    bcache_write(bmap(inode, 0), buffer);
 
     /* Cria tabela de descritores de arquivo em memória */
     fdTable = init_fd_table();
@@ -133,54 +244,75 @@ int fs_mkfs(void) {
     /* Libera memória alocada dinâmicamente */
     free(buffer);
     free(inode);
-    free(rootDirectory);
+
+    /* Escreve no disco o sistema de arquivos recém formatado */
+    flush_bitmaps();
+    flush_inodes();
+    bcache_flush();
+
+    return 0;
+}
+
+int fs_sync(void) {
+    /* Escreve os mapas de bits e os inodes modificados nos seus blocos e depois todos os blocos modificados no disco */
+    flush_bitmaps();
+    flush_inodes();
+    bcache_flush();
 
     return 0;
 }
 
 int fs_open(char *fileName, int flags) {
+    /* Resolve o diretório onde o arquivo fica e o nome do arquivo dentro dele */
+    char name[MAX_FILE_NAME];
+    int dirInodeNumber = resolve_parent(fileName, name);
+
+    if(dirInodeNumber == -1)
+        return -1;
+
+    /* Procura o arquivo no diretório já resolvido (pela cache de dentries), sem percorrer o caminho de novo; -1 se não existe */
+    int inodeNumber = lookup_directory_item(dirInodeNumber, name);
+
     /* Recupera posição do descritor se ele já existe ou -1 caso contrário */
-    int openedFileDescriptor = fd_exists(fileName);
+    int openedFileDescriptor = inodeNumber >= 0 ? fd_exists(dirInodeNumber, inodeNumber) : -1;
 
     /* Verifica se não há descritores disponíveis e se o arquio já não tem um descritor associado (aberto anteriormente) */
     if(numFileDescriptors >= FD_TABLE_SIZE && openedFileDescriptor < 0)
         return -1;
-    
-    /* Recupera o item que representa o arquivo dentro do diretório atual ou NULL caso não encontre */
-    DirectoryItem* directoryItem = NULL;
-    directoryItem = get_directory_item(fileName);
 
     /* FS O RDONLY */
     if(flags == FS_O_RDONLY) {
         /* Verifica se encontrou o arquivo com nome fileName no diretório atual */
-        if(directoryItem == NULL) {
+        if(inodeNumber < 0) {
             return -1;
         }
     /* FS O WRONLY ou FS O RDWR */
     } else if(flags == FS_O_WRONLY || flags == FS_O_RDWR) {
         /* Verifica se encontrou o arquivo com nome fileName no diretório atual */
-        if(directoryItem == NULL) {
+        if(inodeNumber < 0) {
             /* Cria um arquivo no diretório atual caso ele não exista */
-            directoryItem = create_new_file(fileName);
+            DirectoryItem* directoryItem = create_new_file(dirInodeNumber, name);
 
             /* Retorna -1 caso não seja possível criar um novo arquivo */
             if(directoryItem == NULL)
                 return -1;
+
+            inodeNumber = directoryItem->inode;
+
+            /* Libera memória alocada dinâmicamente */
+            free(directoryItem);
         } else {
             /* Guarda o tipo de item (1: diretório, 0: arquivo) */
             int type;
 
             /* Carrega o inode correspondente ao item buscado e recupera seu tipo */
-            Inode* inode = find_inode(directoryItem->inode);
+            Inode* inode = find_inode(inodeNumber);
             type = inode->type;
-            free(inode);
+            release_inode(inode);
 
             /* Verifica se é um diretório e retorna um erro em caso afirmativo */
-            if(type == DIRECTORY) {
-                /* Libera memória alocada dinâmicamente */
-                free(directoryItem);
+            if(type == DIRECTORY)
                 return -1;
-            }
         }
     /* Retorna erro se não foi passado um dos três modos de acesso */
     } else {
@@ -200,32 +332,20 @@ int fs_open(char *fileName, int flags) {
     } else {
         /* Cria um novo descritor de arquivos */
         fd = (File*) malloc(sizeof(File));
-        bcopy((unsigned char*) fileName, (unsigned char*) fd->name, strlen(fileName) + 1);
+        bcopy((unsigned char*) name, (unsigned char*) fd->name, strlen(name) + 1);
         fd->mode = flags;
         fd->offset = 0;
-        fd->inode = directoryItem->inode;
-        fd->directoryInode = superblock->workingDirectory;
+        fd->inode = inodeNumber;
+        fd->directoryInode = dirInodeNumber;
         fd->wasTouched = 0;
+        fd->pinnedInode = find_inode(inodeNumber);
+        fd->blockMap = NULL;
+        fd->mapSize = 0;
 
-        /* Encontra uma posição NULL dentro do vetor de descritores de arquivo */
-        int pos;
-        for(pos = 0; pos < FD_TABLE_SIZE; pos++) {
-            if(fdTable[pos] == NULL)
-                break;
-        }
-
-        /* Guarda o novo descritor de arquivo na posição pos do vetor de descritores de arquivos */
-        fdTable[pos] = fd;
-        /* Incrementa a variável que contabiliza a quantidade de descritores sendo utilizados no momento */
-        numFileDescriptors++;
-
-        /* Guarda a posição do descritor dentro do vetor */
-        openedFileDescriptor = pos;
+        /* Guarda o novo descritor na posição do topo da pilha de descritores livres */
+        openedFileDescriptor = fd_alloc(fd);
     }
 
-    /* Libera memória alocada dinâmicamente */
-    free(directoryItem);
-
     /* Retorna o descritor de arquivo correspondente para o arquivo solicitado */
     return openedFileDescriptor;
 }
@@ -245,12 +365,8 @@ int fs_close(int fd) {
     /* Guarda o inode do diretório ao qual o arquivo pertence */
     int directoryInode = fdTable[fd]->directoryInode;
 
-    /* Libera a memória alocada para o descritor */
-    free(fdTable[fd]);
-    /* Atualiza o ponteiro no vetor de descritores de arquivos para NULL */
-    fdTable[fd] = NULL;
-    /* Decrementa o número de descritores de arquivos */
-    numFileDescriptors--;
+    /* Libera o descritor e devolve a sua posição à pilha de descritores livres */
+    fd_release(fd);
 
     /* Verifica se o número de referências para o arquivo é 0 */
     if(inode->linkCount < 1) {
@@ -262,31 +378,26 @@ int fs_close(int fd) {
         unlink_addarg_count = 0;
     }
 
-    /* Libera memória alocada dinâmicamente */
-    free(inode);
+    /* Devolve o inode à cache */
+    release_inode(inode);
 
     return 0;
 }
 
 int fs_read(int fd, char *buf, int count) {
-    /* Verifica o modo do descritor de arquivos e retorna erro se não é compatível com a operação a ser realizada */
-    if(fdTable[fd]->mode != FS_O_RDONLY && fdTable[fd]->mode != FS_O_RDWR)
+    /* Verifica se o descritor está aberto e se o seu modo é compatível com a operação a ser realizada */
+    if(fd < 0 || fd >= FD_TABLE_SIZE || fdTable[fd] == NULL || (fdTable[fd]->mode != FS_O_RDONLY && fdTable[fd]->mode != FS_O_RDWR))
         return -1;
 
-    /* Recupera inode através do descritor de arquivos */
-    Inode* inode = find_inode(fdTable[fd]->inode);
+    /* Usa o inode mantido na cache enquanto o descritor está aberto */
+    Inode* inode = fdTable[fd]->pinnedInode;
 
     /* Verifica se o inode se trata de um diretório */
     if(inode->type != FILE_TYPE)
         return -1;
 
-    int size;
-
-    /* Recupera tamanho do arquivo (sem contar bloco de dados para endereços) */
-    if(inode->singleIndirect == -1)
-        size = inode->size;
-    else
-        size = inode->size - BLOCK_SIZE;
+    /* Recupera tamanho do arquivo (sem contar blocos de mapeamento) */
+    int size = inode_data_size(inode);
 
     /* Verifica se a posição do ponteiro está depois do fim do arquivo */
     if(fdTable[fd]->offset >= size)
@@ -303,46 +414,25 @@ int fs_read(int fd, char *buf, int count) {
         bytesCount = availableBytes;
     }
 
+    /* Arquivos pequenos são lidos diretamente do inode, sem acessar blocos de dados */
+    if(inode_is_inline(inode)) {
+        bcopy((unsigned char*) &inode->inlineData[fdTable[fd]->offset], (unsigned char*) buf, bytesCount);
+
+        fdTable[fd]->offset += bytesCount;
+
+        return bytesCount;
+    }
+
     /* Calcula os blocos de inicio e término da leitura e byte de início */
     int blockStart = fdTable[fd]->offset / BLOCK_SIZE;
     int blockEnd = (fdTable[fd]->offset + bytesCount - 1) / BLOCK_SIZE;
     int byteStart = fdTable[fd]->offset % BLOCK_SIZE;
 
-    /* Vetor para guardar os possíveis números de blocos de dados */
-    int addresses[139];
-
-    /* Inicializa todos com -1 */
-    for(int i = 0; i < 139; i++)
-        addresses[i] = -1;
-
-    /* Atribui a primeira ao número do bloco do single indirect */
-    addresses[0] = inode->singleIndirect;
-
-    /* Copia os números dos blocos de dados diretos */
-    for(int i = 1; i < 11; i++)
-        addresses[i] = inode->direct[i - 1];
-
-    /* Copia os números dos blocos de dados indiretos simples */
-    if(inode->singleIndirect != -1) {
-        AddressBlock* addressBlock = (AddressBlock*) malloc(sizeof(AddressBlock));
-        char* buffer = (char*) malloc(BLOCK_SIZE * sizeof(char));
-
-        block_read(inode->singleIndirect, buffer);
-
-        bcopy((unsigned char*) buffer, (unsigned char*) addressBlock, sizeof(AddressBlock));
-
-        for(int i = 11; i < 139; i++)
-            addresses[i] = addressBlock->singleIndirect[i - 11];
-
-        free(buffer);
-        free(addressBlock);
-    }
-
     /* Aloca memória para a variável buffer */
     buffer = (char*) malloc((blockEnd - blockStart + 1) * BLOCK_SIZE * sizeof(char));
 
     /* Lê os blocos de dados e guarda no buffer */
-    read_n_blocks(addresses, buffer, blockStart, blockEnd);
+    read_file_blocks(fdTable[fd], buffer, blockStart, blockEnd);
 
     /* Copia bytesCount bytes para a variável buf */
     bcopy((unsigned char*) &buffer[byteStart], (unsigned char*) buf, bytesCount);
@@ -350,7 +440,6 @@ int fs_read(int fd, char *buf, int count) {
     fdTable[fd]->offset += bytesCount;
 
     /* Libera memória alocada dinâmicamente */
-    free(inode);
     free(buffer);
 
     /* Retorna quantidade de bytes lidos */
@@ -358,114 +447,81 @@ int fs_read(int fd, char *buf, int count) {
 }
     
 int fs_write(int fd, char *buf, int count) {
-    /* Verifica o modo do descritor de arquivos e retorna erro se não é compatível com a operação a ser realizada */
-    if(fdTable[fd]->mode != FS_O_WRONLY && fdTable[fd]->mode != FS_O_RDWR)
+    /* Verifica se o descritor está aberto e se o seu modo é compatível com a operação a ser realizada */
+    if(fd < 0 || fd >= FD_TABLE_SIZE || fdTable[fd] == NULL || (fdTable[fd]->mode != FS_O_WRONLY && fdTable[fd]->mode != FS_O_RDWR))
         return -1;
 
-    /* Recupera inode através do descritor de arquivos */
-    Inode* inode = find_inode(fdTable[fd]->inode);
+    /* Usa o inode mantido na cache enquanto o descritor está aberto */
+    Inode* inode = fdTable[fd]->pinnedInode;
 
     /* Verifica se o inode se trata de um diretório */
     if(inode->type != FILE_TYPE)
         return -1;
 
-    int size;
+    int end = fdTable[fd]->offset + count;
 
-    /* Recupera tamanho do arquivo (sem contar bloco de dados para endereços) */
-    if(inode->singleIndirect == -1)
-        size = inode->size;
-    else
-        size = inode->size - BLOCK_SIZE;
-
-    /* Verifica se o ponteiro de escrita está após o fim do arquivo */
-    if(fdTable[fd]->offset > size) {
-        /* Preenche o intermédio entre o fim do arquivo e o ponteiro de escrita com bytes 0s */
-        fill_with_zero_bytes(inode, fdTable[fd]);
-
-        /* Recupera tamanho do arquivo se foi preenchido com 0s */
-        if(inode->singleIndirect == -1)
-            size = inode->size;
-        else
-            size = inode->size - BLOCK_SIZE;
+    /* A primeira escrita trunca o arquivo no fim da escrita; se ele passar a caber no inode, seus dados voltam para lá */
+    if(!inode_is_inline(inode) && !fdTable[fd]->wasTouched && count > 0 && end <= INODE_INLINE_SIZE) {
+        inline_demote(inode);
+        fd_invalidate_block_maps(fdTable[fd]->inode);
     }
 
-    /* Calcula os blocos de inicio e término da escrita e byte de início */
-    int blockStart = fdTable[fd]->offset / BLOCK_SIZE;
-    int blockEnd = (fdTable[fd]->offset + count - 1) / BLOCK_SIZE;
-    int byteStart = fdTable[fd]->offset % BLOCK_SIZE;
+    if(inode_is_inline(inode)) {
+        /* Escreve diretamente no inode enquanto o arquivo couber nele, preenchendo com 0s o intervalo após o fim do arquivo */
+        if(count > 0 && end <= INODE_INLINE_SIZE) {
+            if(fdTable[fd]->offset > inode->size)
+                bzero(&inode->inlineData[inode->size], fdTable[fd]->offset - inode->size);
 
-    /* Vetor para guardar os possíveis números de blocos de dados */
-    int addresses[139];
+            bcopy((unsigned char*) buf, (unsigned char*) &inode->inlineData[fdTable[fd]->offset], count);
 
-    /* Inicializa todos com -1 */
-    for(int i = 0; i < 139; i++)
-        addresses[i] = -1;
+            if(end > inode->size || !fdTable[fd]->wasTouched)
+                inode->size = end;
 
-    /* Atribui a primeira ao número do bloco do single indirect */
-    addresses[0] = inode->singleIndirect;
+            fdTable[fd]->offset = end;
+            fdTable[fd]->wasTouched = 1;
 
-    /* Copia os números dos blocos de dados diretos */
-    for(int i = 1; i < 11; i++)
-        addresses[i] = inode->direct[i - 1];
+            save_inode(inode, fdTable[fd]->inode);
 
-    /* Copia os números dos blocos de dados indiretos simples */
-    if(inode->singleIndirect != -1) {
-        AddressBlock* addressBlock = (AddressBlock*) malloc(sizeof(AddressBlock));
-        char* buffer = (char*) malloc(BLOCK_SIZE * sizeof(char));
+            return count;
+        }
 
-        block_read(inode->singleIndirect, buffer);
+        /* Caso contrário, move os dados para um bloco antes de escrever */
+        if(count > 0 && inline_promote(inode, fdTable[fd]->inode) != 0)
+            return 0;
+    }
 
-        bcopy((unsigned char*) buffer, (unsigned char*) addressBlock, sizeof(AddressBlock));
+    /* Recupera tamanho do arquivo (sem contar blocos de mapeamento) */
+    int size = inode_data_size(inode);
 
-        for(int i = 11; i < 139; i++)
-            addresses[i] = addressBlock->singleIndirect[i - 11];
+    /* Verifica se o ponteiro de escrita está após o fim do arquivo */
+    if(fdTable[fd]->offset > size) {
+        /* Preenche o intermédio entre o fim do arquivo e o ponteiro de escrita com bytes 0s */
+        fill_with_zero_bytes(inode, fdTable[fd]);
 
-        free(buffer);
-        free(addressBlock);
+        /* Recupera tamanho do arquivo se foi preenchido com 0s */
+        size = inode_data_size(inode);
     }
 
-    /* Carrega mapa de bits dos blocos de dados */
-    char dmap[D_MAP_SIZE];
-    load_bitmap(dmap, D_MAP_BLOCK);
-
-    /* Variáveis de controle */
-    int blockNumber;
-    int blockCount = 0;
-
-    /* Aloca blocos de dados para a escrita */
-    for(int i = blockStart; i < blockEnd + 1 && i < 138; i++) {
-        /* Verifica se não há um bloco de dados alocado ni i-ésimo ponteiro direto */
-        if(addresses[i + 1] == -1) {
-            /* Busca um bloco de dados livre */
-            blockNumber = find_free_bit_number(dmap, D_MAP_SIZE);
-
-            /* Verifica se foi possível encontrar um bloco de dados disponível */
-            if(blockNumber == -1)
-                break;
-
-            /* Verifica se está sendo alocado um bloco para o single indirect */
-            if(i == 10 && addresses[0] == -1) {
-                addresses[0] = blockNumber + DATA_BLOCK_START;
-                i--;
-                blockCount--;
-            } else {
-                /* Atualiza o i-ésimo ponteiro direto com o número do bloco de dados livre encontrado */
-                addresses[i + 1] = blockNumber + DATA_BLOCK_START;
-            }
-        }
+    /* Calcula os blocos de inicio e término da escrita e byte de início */
+    int blockStart = fdTable[fd]->offset / BLOCK_SIZE;
+    int blockEnd = (fdTable[fd]->offset + count - 1) / BLOCK_SIZE;
+    int byteStart = fdTable[fd]->offset % BLOCK_SIZE;
 
-        /* Incrementa a quantidade de blocos necessários para realizar a escrita */
-        blockCount++;
-    }
+    /* Aloca blocos de dados contíguos para a escrita */
+    int blockCount = bmap_alloc(inode, fdTable[fd]->inode, blockStart, blockEnd);
 
     /* Calcula quantos bytes estão disponíveis para escrita */
     int bytesCount = blockCount * BLOCK_SIZE - byteStart;
 
+    /* Retorna se não há espaço para nenhum byte */
+    if(bytesCount <= 0)
+        return 0;
+
     /* Aloca memória para a variável buffer */
     buffer = (char*) malloc(blockCount * BLOCK_SIZE * sizeof(char));
 
     /* Lê os blocos de dados onde será feita a escrita e guarda no buffer */
-    read_n_blocks(addresses, buffer, blockStart, blockEnd);
+    read_file_blocks(fdTable[fd], buffer, blockStart, blockStart + blockCount - 1);
 
     /* Verifica se a quantidade de bytes a ser escrita é menor ou igual a quantidade de bytes disponíveis */
     if(count <= bytesCount) {
@@ -476,34 +532,10 @@ int fs_write(int fd, char *buf, int count) {
         bcopy((unsigned char*) buf, (unsigned char*) &buffer[byteStart], bytesCount);
     }
 
-    /* Escreve os bytes do buffer nos blocos de dados correspondente ao do arquivo */
-    write_n_blocks(addresses, buffer, blockStart, blockEnd);
-
-    /* Libera memória alocada dinâmicamente */
-    free(buffer);
-
-    int additionalBytes = 0;
-
-    /* Adiciona BLOCK_SIZE bytes se o arquivo passou a ter um bloco indireto */
-    if((inode->singleIndirect == -1 && addresses[0] != -1) || inode->singleIndirect != -1)
-        additionalBytes += BLOCK_SIZE;
-
     /* Libera os blocos de dados sobrando quando o arquivo diminui de tamanho */
     if(!fdTable[fd]->wasTouched) {
-        for(int i = blockStart + blockCount; i < ((size - 1) / BLOCK_SIZE) + 1; i++) {
-            /* Libera bloco de dados no vetor de bits dos blocos de dados */
-            unset_bit(dmap, (addresses[i + 1] - DATA_BLOCK_START) / 8, (addresses[i + 1] - DATA_BLOCK_START) % 8);
-            
-            /* Atualiza vetor de endereços */
-            addresses[i + 1] = -1;
-
-            /* Libera o bloco alocado para pontos indiretos */
-            if(i == 10) {
-                unset_bit(dmap, (addresses[0] - DATA_BLOCK_START) / 8, (addresses[0] - DATA_BLOCK_START) % 8);
-                addresses[0] = -1;
-                additionalBytes -= BLOCK_SIZE;
-            }
-        }
+        bmap_truncate(inode, blockStart + blockCount);
+        fd_invalidate_block_maps(fdTable[fd]->inode);
     }
 
     /* Atualiza o deslocamento dentro do arquivo */
@@ -515,42 +547,20 @@ int fs_write(int fd, char *buf, int count) {
     /* Verifica se o deslocamento ficou maior que o tamanho do arquivo */
     if(fdTable[fd]->offset > size || (fdTable[fd]->offset < size && !fdTable[fd]->wasTouched)) {
         /* Atualiza o tamanho do arquivo no seu respectivo inode */
-        inode->size = fdTable[fd]->offset + additionalBytes;
+        inode_set_data_size(inode, fdTable[fd]->offset);
     }
 
     /* Atualiza variável para dizer que já foi realizado alguma operação de escrita no arquivo */
     fdTable[fd]->wasTouched = 1;
 
-    /* Atualiza o valor do bloco que contém os ponteiros indiretos */
-    inode->singleIndirect = addresses[0];
-
-    /* Atualiza os blocos de dados diretos */
-    for(int i = 1; i < 11; i++)
-        inode->direct[i - 1] = addresses[i];
-
-    /* Atualiza os blocos de dados indiretos */
-    if(inode->singleIndirect != -1) {
-        AddressBlock* addressBlock = (AddressBlock*) malloc(sizeof(AddressBlock));
-        buffer = (char*) malloc(BLOCK_SIZE * sizeof(char));
-
-        for(int i = 11; i < 139; i++)
-            addressBlock->singleIndirect[i - 11] = addresses[i];
-
-        bcopy((unsigned char*) addressBlock, (unsigned char*) buffer, sizeof(AddressBlock));
-
-        block_write(inode->singleIndirect, buffer);
-
-        free(buffer);
-        free(addressBlock);
-    }
-
-    /* Salva o mapa de bits dos blocos de dados atualizado */
-    save_bitmap(dmap, D_MAP_BLOCK);
     /* Salva o inode atualizado referente ao arquivo onde foi feita a escrita */
     save_inode(inode, fdTable[fd]->inode);
 
+    /* Escreve os blocos de dados, o inode, os mapas de bits e os blocos de mapeamento em uma única submissão ao dispositivo */
+    commit_file_blocks(fdTable[fd], buffer, blockStart, blockStart + blockCount - 1);
+
     /* Libera memória alocada dinâmicamente */
-    free(inode);
+    free(buffer);
 
     /* Verifica se a quantidade de bytes a ser escrita é menor ou igual a quantidade de bytes disponíveis */
     if(count <= bytesCount) {
@@ -562,11 +572,11 @@ int fs_write(int fd, char *buf, int count) {
 
 int fs_lseek(int fd, int offset) {
     /* Verifica se o descritor está aberto */
-    if(fdTable[fd] == NULL)
+    if(fd < 0 || fd >= FD_TABLE_SIZE || fdTable[fd] == NULL)
         return -1;
 
-    /* Recupera inode através do descritor de arquivos */
-    Inode* inode = find_inode(fdTable[fd]->inode);
+    /* Usa o inode mantido na cache enquanto o descritor está aberto */
+    Inode* inode = fdTable[fd]->pinnedInode;
 
     /* Verifica se o inode se trata de um diretório */
     if(inode->type != FILE_TYPE)
@@ -575,361 +585,131 @@ int fs_lseek(int fd, int offset) {
     /* Atualiza o deslocamento do arquivo aberto */
     fdTable[fd]->offset = offset;
 
-    /* Libera memória alocada dinâmicamente */
-    free(inode);
-
     /* Retorna o novo deslocamento */
     return offset;
 }
 
 int fs_mkdir(char *fileName) {
-    /* Verifica se já existe um diretório com o mesmo nome */
-    if(item_exists(fileName))
-        return -1;
-
-    /* Aloca memória para variável buffer */
-    buffer = (char*) malloc(BLOCK_SIZE * sizeof(char));
+    /* Resolve o diretório pai e o nome do novo diretório */
+    char name[MAX_FILE_NAME];
+    int parentInodeNumber = resolve_parent(fileName, name);
 
-    /* Declara vetor de bits para guardar o vetor de bits dos inodes */
-    char imap[I_MAP_SIZE];
-    load_bitmap(imap, I_MAP_BLOCK);
+    /* Verifica se o caminho é válido e se já existe um diretório com o mesmo nome */
+    if(parentInodeNumber == -1 || item_exists(parentInodeNumber, name))
+        return -1;
 
-    /* Encontra inode livre */
-    int inodeNumber = find_free_bit_number(imap, I_MAP_SIZE);
+    /* Encontra inode livre, em um grupo com espaço livre para espalhar os diretórios pelo disco */
+    int inodeNumber = alloc_inode(parentInodeNumber, 1);
 
     /* Checa se houve sucesso em encontrar um inode livre */
     if(inodeNumber == -1)
         return -1;
 
-    /* Salva mapa de bits atualizado no disco */
-    save_bitmap(imap, I_MAP_BLOCK);
-
-    /* Declara vetor de bits para guardar o vetor de bits dos blocos de dados */
-    char dmap[D_MAP_SIZE];
-    load_bitmap(dmap, D_MAP_BLOCK);
-
-    /* Encontra bloco de dados livre */
-    int blockNumber = find_free_bit_number(dmap, D_MAP_SIZE);
-
-    /* Checa se houve sucesso em encontrar um bloco de dados livre */
-    if(blockNumber == -1)
-        return -1;
-
-    /* Salva mapa de bits atualizado no disco */
-    save_bitmap(dmap, D_MAP_BLOCK);
-
-    /* Cria as entradas . e .. de um diretório vazio */
-    DirectoryItem* newDirectory = (DirectoryItem*) malloc(2 * sizeof(DirectoryItem));
-    bcopy((unsigned char*) dirEntry1, (unsigned char*) newDirectory[0].name, MAX_FILE_NAME);
-    newDirectory[0].inode = inodeNumber;
-    bcopy((unsigned char*) dirEntry2, (unsigned char*) newDirectory[1].name, MAX_FILE_NAME);
-    newDirectory[1].inode = superblock->workingDirectory;
-
-    /* Escreve no disco o diretório criado no bloco correspondente ao diretório */
-    bzero(buffer, BLOCK_SIZE);
-    bcopy((unsigned char*) newDirectory, (unsigned char*) buffer, 2 * sizeof(DirectoryItem));
-    block_write(blockNumber + DATA_BLOCK_START, buffer);
-
-    free(buffer);
-
-    /* Aloca inode para o novo diretório criado */
+    /* Aloca inode para o novo diretório criado, junto com seu primeiro bloco de dados */
     Inode* newInode = create_new_inode();
     newInode->type = DIRECTORY;
-    newInode->size = 2 * sizeof(DirectoryItem);
-    newInode->direct[0] = blockNumber + DATA_BLOCK_START;
-
-    /* Salva o inode correspondente ao diretório no disco */
-    save_inode(newInode, inodeNumber);
 
-    /* Recupera o inode do diretório atual */
-    Inode* inode = find_inode(superblock->workingDirectory);
-
-    /* Checa se encontrou inode */
-    if(inode == NULL)
+    /* Checa se houve sucesso em encontrar um bloco de dados livre e devolve o inode alocado caso contrário */
+    if(bmap_alloc(newInode, inodeNumber, 0, 0) == 0) {
+        free_bit(&inodeBitmap, inodeNumber);
+        free(newInode);
         return -1;
-
-    int size;
-
-    /* Recupera tamanho do arquivo (sem contar bloco de dados para endereços) */
-    if(inode->singleIndirect == -1)
-        size = inode->size;
-    else
-        size = inode->size - BLOCK_SIZE;
-
-    /* Calcula o bloco de inicio e termino correspondente ao diretório atual */
-    int blockStart = size / BLOCK_SIZE;
-    int blockEnd = (size + sizeof(DirectoryItem) - 1) / BLOCK_SIZE;
-    int byteStart = size % BLOCK_SIZE;
-
-    /* Vetor para guardar os possíveis números de blocos de dados */
-    int addresses[139];
-
-    /* Inicializa todos com -1 */
-    for(int i = 0; i < 139; i++)
-        addresses[i] = -1;
-
-    /* Atribui a primeira ao número do bloco do single indirect */
-    addresses[0] = inode->singleIndirect;
-
-    /* Copia os números dos blocos de dados diretos */
-    for(int i = 1; i < 11; i++)
-        addresses[i] = inode->direct[i - 1];
-
-    /* Copia os números dos blocos de dados indiretos simples */
-    if(inode->singleIndirect != -1) {
-        AddressBlock* addressBlock = (AddressBlock*) malloc(sizeof(AddressBlock));
-        buffer = (char*) malloc(BLOCK_SIZE * sizeof(char));
-
-        block_read(inode->singleIndirect, buffer);
-
-        bcopy((unsigned char*) buffer, (unsigned char*) addressBlock, sizeof(AddressBlock));
-
-        for(int i = 11; i < 139; i++)
-            addresses[i] = addressBlock->singleIndirect[i - 11];
-
-        free(buffer);
-        free(addressBlock);
     }
 
-    /* Carrega mapa de bits dos blocos de dados */
-    load_bitmap(dmap, D_MAP_BLOCK);
-
-    /* Variáveis de controle */
-    int blockCount = 0;
-
-    /* Aloca blocos de dados para a escrita */
-    for(int i = blockStart; i < blockEnd + 1 && i < 138; i++) {
-        /* Verifica se não há um bloco de dados alocado ni i-ésimo ponteiro direto */
-        if(addresses[i + 1] == -1) {
-            /* Busca um bloco de dados livre */
-            blockNumber = find_free_bit_number(dmap, D_MAP_SIZE);
-
-            /* Verifica se foi possível encontrar um bloco de dados disponível */
-            if(blockNumber == -1)
-                break;
-
-            /* Verifica se está sendo alocado um bloco para o single indirect */
-            if(i == 10 && addresses[0] == -1) {
-                addresses[0] = blockNumber + DATA_BLOCK_START;
-                i--;
-                blockCount--;
-            } else {
-                /* Atualiza o i-ésimo ponteiro com o número do bloco de dados livre encontrado */
-                addresses[i + 1] = blockNumber + DATA_BLOCK_START;
-            }
-        }
-
-        /* Incrementa a quantidade de blocos necessários para realizar a escrita */
-        blockCount++;
-    }
+    /* Cria as entradas . e .. de um diretório vazio e escreve no disco o bloco correspondente ao diretório */
+    buffer = (char*) malloc(BLOCK_SIZE * sizeof(char));
+    dir_block_init_empty(buffer, inodeNumber, parentInodeNumber);
+    bcache_write(bmap(newInode, 0), buffer);
 
-    /* Aloca memória para ler os bytes do diretório */
-    buffer = (char*) malloc((blockEnd - blockStart + 1) * BLOCK_SIZE * sizeof(char));
+    free(buffer);
 
-    /* Lê os blocos onde o diretório atual está salvo */
-    read_n_blocks(addresses, buffer, blockStart, blockEnd);
+    inode_set_data_size(newInode, BLOCK_SIZE);
 
     /* Cria entrada do novo diretório */
     DirectoryItem* directory = (DirectoryItem*) malloc(sizeof(DirectoryItem));
-    bcopy((unsigned char*) fileName, (unsigned char*) directory->name, strlen(fileName) + 1);
+    bcopy((unsigned char*) name, (unsigned char*) directory->name, strlen(name) + 1);
     directory->inode = inodeNumber;
 
-    /* Guarda o novo diretório criado dentro do bloco de dados do diretório atual */
-    bcopy((unsigned char*) directory, (unsigned char*) &buffer[byteStart], sizeof(DirectoryItem));
-
-    write_n_blocks(addresses, buffer, blockStart, blockEnd);
-
-    free(buffer);
-
-    int additionalBytes = 0;
-
-    /* Adiciona BLOCK_SIZE bytes se o arquivo passou a ter um bloco indireto */
-    if(inode->singleIndirect == -1 && addresses[0] != -1)
-        additionalBytes = BLOCK_SIZE;
-
-    /* Atualiza o valor do bloco que contém os ponteiros indiretos */
-    inode->singleIndirect = addresses[0];
-
-    /* Atualiza os blocos de dados diretos */
-    for(int i = 1; i < 11; i++)
-        inode->direct[i - 1] = addresses[i];
-
-    /* Atualiza os blocos de dados indiretos */
-    if(inode->singleIndirect != -1) {
-        AddressBlock* addressBlock = (AddressBlock*) malloc(sizeof(AddressBlock));
-        buffer = (char*) malloc(BLOCK_SIZE * sizeof(char));
-
-        for(int i = 11; i < 139; i++)
-            addressBlock->singleIndirect[i - 11] = addresses[i];
+    /* Guarda o novo diretório criado no fim do diretório pai e desfaz as alocações em caso de erro */
+    int result = append_directory_item(parentInodeNumber, directory, DIRECTORY);
 
-        bcopy((unsigned char*) addressBlock, (unsigned char*) buffer, sizeof(AddressBlock));
-
-        block_write(inode->singleIndirect, buffer);
-
-        free(buffer);
-        free(addressBlock);
+    if(result == 0) {
+        /* Salva o inode correspondente ao diretório no disco */
+        save_inode(newInode, inodeNumber);
+    } else {
+        bmap_truncate(newInode, 0);
+        free_bit(&inodeBitmap, inodeNumber);
     }
 
-    /* Atualiza o tamanho do diretório atual */
-    inode->size += sizeof(DirectoryItem) + additionalBytes;
-    save_inode(inode, superblock->workingDirectory);
-
     /* Libera memória alocada dinamicamente */
     free(directory);
-    free(newDirectory);
     free(newInode);
-    free(inode);
-    
-    return 0;
+
+    return result;
 }
 
-int fs_rmdir( char *fileName) {
-    /* Verifica se o diretório existe */
-    if(!item_exists(fileName))
+int fs_rmdir( char *path) {
+    /* Resolve o diretório pai e o nome do diretório a ser removido */
+    char fileName[MAX_FILE_NAME];
+    int parentInodeNumber = resolve_parent(path, fileName);
+
+    if(parentInodeNumber == -1)
         return -1;
     
     /* Certifica-se de que não seja os diretórios . ou .. */
     if(same_string(fileName, ".") || same_string(fileName, ".."))
         return -1;
 
-    /* Recupera o inode do diretório atual */
-    Inode* inode = find_inode(superblock->workingDirectory);
+    /* Recupera o inode do diretório pai */
+    Inode* inode = find_inode(parentInodeNumber);
 
-    /* Recupera a lista de diretórios dentro do diretório atual */
-    DirectoryItem* directoryItems = get_directory_items(superblock->workingDirectory);
+    /* Procura a entrada do diretório a ser removido e verifica se ela existe */
+    DirectoryItem directoryItem;
+    int position = find_directory_record(inode, fileName, &directoryItem);
 
-    /* Verifica se foi retornado uma lista de diretórios */
-    if(directoryItems == NULL)
+    if(position == -1) {
+        release_inode(inode);
         return -1;
+    }
 
-    /* Percorre a lista de diretórios */
-    for(int i = 0; i < (inode->size / sizeof(DirectoryItem)); i++) {
-        /* Verifica se o nome do diretório é o mesmo que está sendo procurado */
-        if(same_string(directoryItems[i].name, fileName)) {
-
-            /* Carrega o inode do diretório a ser removido */
-            Inode* dirInode = find_inode(directoryItems[i].inode);
-
-            /* Verifica se o inode não é de um diretório ou se o diretório não está vazio */
-            if(dirInode->type != DIRECTORY || dirInode->size != (2 * sizeof(DirectoryItem)))
-                return -1;
-
-            /* Carrega o vetor de bits dos inodes para um vetor */
-            char imap[I_MAP_SIZE];
-            load_bitmap(imap, I_MAP_BLOCK);
-            
-            /* Seta para 0 o bit correspondente ao inode do diretório a ser removido */
-            unset_bit(imap, (directoryItems[i].inode / 8), (directoryItems[i].inode % 8));
-
-            /* Copia o vetor de bits dos inodes modificado de volta para o disco */
-            save_bitmap(imap, I_MAP_BLOCK);
-
-            /* Vetor para guardar os possíveis números de blocos de dados */
-            int addresses[139];
-
-            /* Inicializa todos com -1 */
-            for(int i = 0; i < 139; i++)
-                addresses[i] = -1;
-
-            /* Atribui a primeira ao número do bloco do single indirect */
-            addresses[0] = inode->singleIndirect;
-
-            /* Copia os números dos blocos de dados diretos */
-            for(int i = 1; i < 11; i++)
-                addresses[i] = inode->direct[i - 1];
-
-            /* Copia os números dos blocos de dados indiretos simples */
-            if(inode->singleIndirect != -1) {
-                AddressBlock* addressBlock = (AddressBlock*) malloc(sizeof(AddressBlock));
-                buffer = (char*) malloc(BLOCK_SIZE * sizeof(char));
-
-                block_read(inode->singleIndirect, buffer);
-
-                bcopy((unsigned char*) buffer, (unsigned char*) addressBlock, sizeof(AddressBlock));
-
-                for(int i = 11; i < 139; i++)
-                    addresses[i] = addressBlock->singleIndirect[i - 11];
-
-                free(buffer);
-                free(addressBlock);
-            }
-
-            int size;
-
-            /* Recupera tamanho do arquivo (sem contar bloco de dados para endereços) */
-            if(inode->singleIndirect == -1)
-                size = inode->size;
-            else
-                size = inode->size - BLOCK_SIZE;
-
-            /* Move os diretórios uma posição a menos a partir do diretório removido */
-            for(int j = i; j < (size / sizeof(DirectoryItem)) - 1; j++) {
-                directoryItems[j] = directoryItems[j + 1];
-            }
-
-            /* Calcula quantos blocos de dados o diretório precisa */
-            int numBlocks = (int) ceil((double) (size - sizeof(DirectoryItem) - 1) / BLOCK_SIZE);
-
-            /* Carrega o vetor de bits dos blocos de dados para um vetor */
-            char dmap[D_MAP_SIZE];
-            load_bitmap(dmap, D_MAP_BLOCK);
-
-            /* Seta para 0 os bits correspondentes aos blocos de dados que não serão mais utilizados */
-            for(int i = numBlocks; i < (int) ceil((double) (size - 1) / BLOCK_SIZE); i++) {
-                unset_bit(dmap, (addresses[i + 1] - DATA_BLOCK_START) / 8, (addresses[i + 1] - DATA_BLOCK_START) % 8);
-
-                /* Atualiza vetor de endereços */
-                addresses[i + 1] = -1;
-
-                /* Libera o bloco alocado para pontos indiretos */
-                if(i == 10) {
-                    unset_bit(dmap, (addresses[0] - DATA_BLOCK_START) / 8, (addresses[0] - DATA_BLOCK_START) % 8);
-                    addresses[0] = -1;
-                }
-            }
-
-            int additionalBytes = 0;
-
-            /* Adiciona BLOCK_SIZE bytes se o arquivo passou a ter um bloco indireto */
-            if(inode->singleIndirect != -1 && addresses[0] == -1)
-                additionalBytes = BLOCK_SIZE;
+    /* Carrega o inode do diretório a ser removido */
+    Inode* dirInode = find_inode(directoryItem.inode);
 
-            /* Altera o tamanho do diretório no seu inode e salva no disco o inode */
-            inode->size -= sizeof(DirectoryItem) - additionalBytes;
+    /* Verifica se o inode não é de um diretório, se o diretório não está vazio ou se é o diretório atual */
+    if(dirInode->type != DIRECTORY || !dir_is_empty(dirInode) ||
+       directoryItem.inode == superblock->workingDirectory) {
+        release_inode(dirInode);
+        release_inode(inode);
+        return -1;
+    }
 
-            /* Copia a lista de diretórios modificada de volta para a variável buffer */
-            buffer = (char*) malloc(numBlocks * BLOCK_SIZE * sizeof(char));
-            bcopy((unsigned char*) directoryItems, (unsigned char*) buffer, (size - sizeof(DirectoryItem)));
+    /* Seta para 0 o bit correspondente ao inode do diretório a ser removido */
+    free_bit(&inodeBitmap, directoryItem.inode);
 
-            /* Salva no disco o conteúdo da variável buffer nos seus respectivos blocos de dados */
-            write_n_blocks(addresses, buffer, 0, numBlocks - 1);
+    /* Libera os blocos de dados e o índice do diretório removido */
+    dir_index_free(dirInode);
+    bmap_truncate(dirInode, 0);
 
-            /* Calcula quantos blocos de dados o diretório removido estava ocupando */
-            numBlocks = ((dirInode->size - 1) / BLOCK_SIZE) + 1;
+    /* O inode deixa de ser um diretório, inclusive na cópia em memória vista por quem ainda o tem aberto */
+    dirInode->type = 0;
+    inode_set_data_size(dirInode, 0);
+    save_inode(dirInode, directoryItem.inode);
 
-            /* Seta para 0 os bits correspondentes aos blocos de dados do diretório removido */
-            for(int i = 0; i < numBlocks; i++) {
-                unset_bit(dmap, (dirInode->direct[i] - DATA_BLOCK_START) / 8, (dirInode->direct[i] - DATA_BLOCK_START) % 8);
-            }
-            
-            /* Copia o vetor de bits dos blocos de dados modificado de volta para o disco */
-            save_bitmap(dmap, D_MAP_BLOCK);
+    /* Cursores abertos no diretório removido passam a falhar, mesmo que o inode seja reaproveitado */
+    for(int dd = 0; dd < DIR_TABLE_SIZE; dd++) {
+        if(dirTable[dd] != NULL && dirTable[dd]->inode == directoryItem.inode)
+            dirTable[dd]->inode = -1;
+    }
 
-            /* Salva informações do inode */
-            save_inode(inode, superblock->workingDirectory);
-            
-            /* Libera memória alocada dinâmicamente */
-            free(buffer);
-            free(dirInode);
+    /* Remove a entrada do diretório pai, que também é salvo no disco */
+    remove_directory_item(parentInodeNumber, inode, position, fileName);
 
-            /* Encerra o loop pela lista de diretórios */
-            break;
-        }
-    }
+    /* As entradas do diretório removido saem da cache de dentries */
+    dcache_purge_directory(directoryItem.inode);
 
     /* Libera memória alocada dinâmicamente */
-    free(directoryItems);
-    free(inode);
+    release_inode(dirInode);
+    release_inode(inode);
 
     return 0;
 }
@@ -946,22 +726,29 @@ int fs_cd(char *dirName) {
     Inode* inode = find_inode(directoryItem->inode);
 
     /* Verifica se realmente é um diretório */
-    if(inode->type != DIRECTORY)
+    if(inode->type != DIRECTORY) {
+        release_inode(inode);
+        free(directoryItem);
         return -1;
+    }
 
     /* Altera o inode que corresponde ao diretório de trabalho atual no superbloco */
     superblock->workingDirectory = directoryItem->inode;
 
     /* Libera memória alocada */
     free(directoryItem);
-    free(inode);
+    release_inode(inode);
 
     return 0;
 }
 
 int fs_link(char *old_fileName, char *new_fileName) {
+    /* Resolve o diretório onde o soft link será criado e o seu nome */
+    char name[MAX_FILE_NAME];
+    int dirInodeNumber = resolve_parent(new_fileName, name);
+
     /* Verifica se já há um diretório/arquivo com o mesmo nome do soft link e retorna um erro caso sim */
-    if(item_exists(new_fileName))
+    if(dirInodeNumber == -1 || item_exists(dirInodeNumber, name))
         return -1;
 
     /* Recupera o item referente ao arquivo buscado */
@@ -975,90 +762,33 @@ int fs_link(char *old_fileName, char *new_fileName) {
     Inode* inode = find_inode(directoryItem->inode);
 
     /* Verifica se o inode corresponde a um inode de diretório e caso sim retorna erro */
-    if(inode->type != FILE_TYPE)
+    if(inode->type != FILE_TYPE) {
+        release_inode(inode);
+        free(directoryItem);
         return -1;
+    }
 
     /* Cria um novo item de diretório com número de inode igual ao número do inode do arquivo old_fileName */
     DirectoryItem* newDirectoryItem = (DirectoryItem*) malloc(sizeof(DirectoryItem));
-    bcopy((unsigned char*) new_fileName, (unsigned char*) newDirectoryItem->name, strlen(new_fileName) + 1);
+    bcopy((unsigned char*) name, (unsigned char*) newDirectoryItem->name, strlen(name) + 1);
     newDirectoryItem->inode = directoryItem->inode;
 
-    /* Carrega o inode do diretório atual */
-    Inode* workingDirectoryInode = find_inode(superblock->workingDirectory);
-
-    /* Calcula o bloco de inicio e termino correspondente ao diretório atual e o próximo byte livre para ser escrito (byteStart) */
-    int blockStart = workingDirectoryInode->size / BLOCK_SIZE;
-    int blockEnd = (workingDirectoryInode->size + sizeof(DirectoryItem) - 1) / BLOCK_SIZE;
-    int byteStart = workingDirectoryInode->size % BLOCK_SIZE;
-
-    /* Declara vetor de bits para guardar o vetor de bits dos blocos de dados */
-    char dmap[D_MAP_SIZE];
-    load_bitmap(dmap, D_MAP_BLOCK);
-
-    /* Variáveis de controle */
-    int blockNumber;
-    int blockCount = 0;
-
-    /* Aloca blocos de dados para a escrita */
-    for(int i = blockStart; i < blockEnd + 1 && i < (sizeof(workingDirectoryInode->direct) / 4); i++) {
-        /* Verifica se não há um bloco de dados alocado ni i-ésimo ponteiro direto */
-        if(workingDirectoryInode->direct[i] == -1) {
-            /* Busca um bloco de dados livre */
-            blockNumber = find_free_bit_number(dmap, D_MAP_SIZE);
-
-            /* Verifica se foi possível encontrar um bloco de dados disponível */
-            if(blockNumber == -1)
-                break;
-
-            /* Atualiza o i-ésimo ponteiro direto com o número do bloco de dados livre encontrado */
-            workingDirectoryInode->direct[i] = blockNumber + DATA_BLOCK_START;
-        }
-
-        /* Incrementa a quantidade de blocos necessários para realizar a escrita */
-        blockCount++;
-    }
-
-    /* Calcula quantos bytes estão disponíveis para escrita */
-    int bytesCount = blockCount * BLOCK_SIZE - byteStart;
-
-    /* Aloca memória para a variável buffer */
-    buffer = (char*) malloc(blockCount * BLOCK_SIZE * sizeof(char));
-
-    /* Lê os blocos de dados onde será feita a escrita e guarda no buffer */
-    for(int i = blockStart; i < blockStart + blockCount; i++) {
-        block_read(workingDirectoryInode->direct[i], &buffer[(i - blockStart) * BLOCK_SIZE]);
-    }
-
-    /* Verifica se a quantidade de bytes a ser escrita é menor ou igual a quantidade de bytes disponíveis */
-    if(sizeof(DirectoryItem) <= bytesCount) {
-        /* Copia sizeof(DirectoryItem) bytes para a variável buffer */
-        bcopy((unsigned char*) newDirectoryItem, (unsigned char*) &buffer[byteStart], sizeof(DirectoryItem));
-    } else {
-        /* Retorna erro caso não haja espaço disponível para inserir o novo link */
+    /* Guarda o novo item no fim do diretório e retorna erro caso não haja espaço disponível */
+    if(append_directory_item(dirInodeNumber, newDirectoryItem, FILE_TYPE) != 0) {
+        release_inode(inode);
+        free(directoryItem);
+        free(newDirectoryItem);
         return -1;
     }
 
-    /* Escreve os bytes do buffer nos blocos de dados correspondente ao do arquivo */
-    for(int i = blockStart; i < blockStart + blockCount; i++) {
-        block_write(workingDirectoryInode->direct[i], &buffer[(i - blockStart) * BLOCK_SIZE]);
-    }
-
-    /* Atualiza o tamanho do diretório atual */
-    workingDirectoryInode->size += sizeof(DirectoryItem);
     /* Incrementa a quantidade de soft links do arquivo para o qual está sendo criado um novo link */
     inode->linkCount++;
 
-    /* Salva o mapa de bits dos blocos de dados atualizado */
-    save_bitmap(dmap, D_MAP_BLOCK);
-    /* Salva o inode atualizado referente ao arquivo onde foi feita a escrita */
-    save_inode(workingDirectoryInode, superblock->workingDirectory);
     /* Salva o inode modificado do arquivo que está sendo criado o soft link */
     save_inode(inode, directoryItem->inode);
 
     /* Libera memória alocada dinâmicamente */
-    free(buffer);
-    free(inode);
-    free(workingDirectoryInode);
+    release_inode(inode);
     free(directoryItem);
     free(newDirectoryItem);
 
@@ -1068,11 +798,17 @@ int fs_link(char *old_fileName, char *new_fileName) {
 int fs_unlink(char *fileName, ...) {
     /* Variável utilizada para guardar o número do inode do diretório onde o arquivo que será removido pertence */
     int dirInodeNumber;
+    char name[MAX_FILE_NAME];
 
     /* Verifica se não está sendo passado o número do inode do diretório na função fs_unlink */
     if(unlink_addarg_count == 0) {
-        /* Se não, seta o número do inode para o número do inode do diretório atual */
-        dirInodeNumber = superblock->workingDirectory;
+        /* Se não, fileName é um caminho: resolve o diretório e o nome do arquivo dentro dele */
+        dirInodeNumber = resolve_parent(fileName, name);
+
+        if(dirInodeNumber == -1)
+            return -1;
+
+        fileName = name;
     } else {
         /* Se sim, seta o número do inode para o número do inode recebido no parâmetro da função */
         va_list args;
@@ -1083,165 +819,76 @@ int fs_unlink(char *fileName, ...) {
         va_end(args);
     }
 
-    /* Recupera o item referente ao arquivo buscado */
-    DirectoryItem* directoryItem = get_directory_item(fileName, dirInodeNumber);
+    /* Recupera o inode do arquivo buscado */
+    int itemInodeNumber = lookup_directory_item(dirInodeNumber, fileName);
 
     /* Verifica se não encontrou um arquivo com nome igual a fileName */
-    if(directoryItem == NULL)
+    if(itemInodeNumber < 0)
         return -1;
 
     /* Recupera o inode referente ao arquivo para o qual será excluido um soft link */
-    Inode* softLinkInode = find_inode(directoryItem->inode);
+    Inode* softLinkInode = find_inode(itemInodeNumber);
 
     /* Verifica se o inode corresponde a um inode de diretório e caso sim retorna erro */
-    if(softLinkInode->type != FILE_TYPE)
+    if(softLinkInode->type != FILE_TYPE) {
+        release_inode(softLinkInode);
         return -1;
+    }
 
     /* Verifica se há um descritor de arquivos aberto e se o arquivo só tem uma referência para ele */
-    for(int i = 0; i < FD_TABLE_SIZE; i++)  {
-        if(fdTable[i] != NULL && fdTable[i]->inode == directoryItem->inode && softLinkInode->linkCount <= 1) {
-            /* Decrementa número de referências do arquivo para 0 */
-            softLinkInode->linkCount = 0;
-            /* Salva o inode do arquivo modificado */
-            save_inode(softLinkInode, directoryItem->inode);
+    int i = fd_find_inode(itemInodeNumber);
 
-            /* Atualiza o nome do descritor de arquivos para o nome da última referência para o arquivo */
-            bcopy((unsigned char*) directoryItem->name, (unsigned char*) fdTable[i]->name, strlen(directoryItem->name) + 1);
+    if(i != -1 && softLinkInode->linkCount <= 1) {
+        /* Decrementa número de referências do arquivo para 0 */
+        softLinkInode->linkCount = 0;
+        /* Salva o inode do arquivo modificado */
+        save_inode(softLinkInode, itemInodeNumber);
 
-            return 0;
-        }
+        /* Atualiza o nome do descritor de arquivos para o nome da última referência para o arquivo */
+        bcopy((unsigned char*) fileName, (unsigned char*) fdTable[i]->name, strlen(fileName) + 1);
+        fdTable[i]->directoryInode = dirInodeNumber;
+
+        release_inode(softLinkInode);
+
+        return 0;
     }
 
-    /* Recupera a lista de diretórios/arquivos dentro do diretório atual */
-    DirectoryItem* directoryItems = get_directory_items(dirInodeNumber);
+    /* Recupera inode do diretório */
+    Inode* inode = find_inode(dirInodeNumber);
+
+    /* Procura a posição da entrada do arquivo no diretório */
+    DirectoryItem directoryItem;
+    int position = find_directory_record(inode, fileName, &directoryItem);
 
-    /* Verifica se foi retornado uma lista de diretórios/arquivos */
-    if(directoryItems == NULL)
+    if(position == -1) {
+        release_inode(softLinkInode);
+        release_inode(inode);
         return -1;
+    }
 
-    /* Recupera inode do diretório atual */
-    Inode* inode = find_inode(dirInodeNumber);
+    /* Verifica se há somente uma referência para o arquivo */
+    if(softLinkInode->linkCount <= 1) {
 
-    /* Percorre a lista de diretórios/arquivos */
-    for(int i = 0; i < (inode->size / sizeof(DirectoryItem)); i++) {
-        /* Verifica se o nome do arquivo é o mesmo que está sendo procurado */
-        if(same_string(directoryItems[i].name, fileName)) {
-            int numBlocks;
+        /* Seta para 0 o bit correspondente ao inode do arquivo a ser removido */
+        free_bit(&inodeBitmap, itemInodeNumber);
 
-            /* Verifica se há somente uma referência para o arquivo */
-            if(softLinkInode->linkCount <= 1) {
-                /* Carrega o vetor de bits dos inodes para um vetor */
-                char imap[I_MAP_SIZE];
-                load_bitmap(imap, I_MAP_BLOCK);
-
-                /* Seta para 0 o bit correspondente ao inode do arquivo a ser removido */
-                unset_bit(imap, (directoryItems[i].inode / 8), (directoryItems[i].inode % 8));
-
-                /* Salva o vetor de bits dos inodes atualizado */
-                save_bitmap(imap, I_MAP_BLOCK);
-
-                /* Carrega o vetor de bits dos blocos de dados para um vetor */
-                char dmap[D_MAP_SIZE];
-                load_bitmap(dmap, D_MAP_BLOCK);
-
-                int size;
-
-                /* Recupera tamanho do arquivo (sem contar bloco de dados para endereços) */
-                if(softLinkInode->singleIndirect == -1)
-                    size = softLinkInode->size;
-                else
-                    size = softLinkInode->size - BLOCK_SIZE;
-
-                /* Calcula quantos blocos de dados o arquivo removido estava ocupando */
-                numBlocks = (int) ceil((double) size / BLOCK_SIZE);
-
-                /* Vetor para guardar os possíveis números de blocos de dados */
-                int addresses[139];
-
-                /* Inicializa todos com -1 */
-                for(int i = 0; i < 139; i++)
-                    addresses[i] = -1;
-
-                /* Atribui a primeira ao número do bloco do single indirect */
-                addresses[0] = softLinkInode->singleIndirect;
-
-                /* Copia os números dos blocos de dados diretos */
-                for(int i = 1; i < 11; i++)
-                    addresses[i] = softLinkInode->direct[i - 1];
-
-                /* Copia os números dos blocos de dados indiretos simples */
-                if(softLinkInode->singleIndirect != -1) {
-                    AddressBlock* addressBlock = (AddressBlock*) malloc(sizeof(AddressBlock));
-                    buffer = (char*) malloc(BLOCK_SIZE * sizeof(char));
-
-                    block_read(softLinkInode->singleIndirect, buffer);
-
-                    bcopy((unsigned char*) buffer, (unsigned char*) addressBlock, sizeof(AddressBlock));
-
-                    for(int i = 11; i < 139; i++)
-                        addresses[i] = addressBlock->singleIndirect[i - 11];
-
-                    free(buffer);
-                    free(addressBlock);
-                }
-
-                /* Seta para 0 os bits correspondentes aos blocos de dados do arquivo removido */
-                for(int i = 0; i < numBlocks; i++) {
-                    unset_bit(dmap, (addresses[i + 1] - DATA_BLOCK_START) / 8, (addresses[i + 1] - DATA_BLOCK_START) % 8);
-
-                    /* Atualiza vetor de endereços */
-                    addresses[i + 1] = -1;
-
-                    /* Libera o bloco alocado para pontos indiretos */
-                    if(i == 10) {
-                        unset_bit(dmap, (addresses[0] - DATA_BLOCK_START) / 8, (addresses[0] - DATA_BLOCK_START) % 8);
-                        addresses[0] = -1;
-                    }
-                }
-
-                /* Salva o vetor de bits dos blocos de dados atualizado */
-                save_bitmap(dmap, D_MAP_BLOCK);
-            } else {
-                /* Decrementa a quantidade de referências para o arquivo */
-                softLinkInode->linkCount--;
-                /* Salva o inode atualizado do arquivo para o qual foi decrementado uma referência */
-                save_inode(softLinkInode, directoryItems[i].inode);
-            }
-
-            /* Move os itens uma posição a menos a partir do arquivo removido */
-            for(int j = i; j < (inode->size / sizeof(DirectoryItem)) - 1; j++) {
-                directoryItems[j] = directoryItems[j + 1];
-            }
-
-            /* Altera o tamanho do diretório atual no seu inode e salva no disco o inode */
-            inode->size -= sizeof(DirectoryItem);
-            save_inode(inode, dirInodeNumber);
-
-            /* Calcula quantos blocos são necessários para guardar os diretórios/arquivos restantes */
-            numBlocks = (int) ceil((double) inode->size / BLOCK_SIZE);
-
-            /* Copia a lista de diretórios/arquivos modificada de volta para a variável buffer */
-            buffer = (char*) malloc(numBlocks * BLOCK_SIZE * sizeof(char));
-            bcopy((unsigned char*) directoryItems, (unsigned char*) buffer, inode->size);
-
-            /* Salva no disco o conteúdo da variável buffer nos seus respectivos blocos de dados */
-            for(int i = 0; i < numBlocks; i++) {
-                block_write(inode->direct[i], &buffer[i * BLOCK_SIZE]);
-            }
-            
-            /* Libera memória alocada dinâmicamente */
-            free(buffer);
+        /* Libera os blocos de dados do arquivo removido */
+        bmap_truncate(softLinkInode, 0);
+        fd_invalidate_block_maps(itemInodeNumber);
 
-            /* Encerra o loop pela lista de diretórios */
-            break;
-        }
+    } else {
+        /* Decrementa a quantidade de referências para o arquivo */
+        softLinkInode->linkCount--;
+        /* Salva o inode atualizado do arquivo para o qual foi decrementado uma referência */
+        save_inode(softLinkInode, itemInodeNumber);
     }
 
+    /* Remove a entrada do diretório, que também é salvo no disco */
+    remove_directory_item(dirInodeNumber, inode, position, fileName);
+
     /* Libera memória alocada dinâmicamente */
-    free(directoryItems);
-    free(directoryItem);
-    free(softLinkInode);
-    free(inode);
+    release_inode(softLinkInode);
+    release_inode(inode);
 
     return 0;
 }
@@ -1258,44 +905,174 @@ int fs_stat( char *fileName, fileStat *buf) {
     Inode* inode = find_inode(directoryItem->inode);
 
     /* Copia as informações sobre o arquivo/diretório para o buffer passado por referência */
-    buf->inodeNo = directoryItem->inode;
-    buf->type = inode->type;
-    buf->links = inode->linkCount;
-    buf->size = inode->size;
-    buf->numBlocks = ceil((double) inode->size / BLOCK_SIZE);
+    fill_file_stat(inode, directoryItem->inode, buf);
+
+    /* Libera memória alocada dinâmicamente */
+    free(directoryItem);
+    release_inode(inode);
+
+    return 0;
+}
+
+int fs_statfs(fsStat* buf) {
+    /* Os contadores dos mapas de bits residentes tornam a consulta O(1) */
+    buf->blockSize = BLOCK_SIZE;
+    buf->totalBlocks = dataBitmap.size;
+    buf->freeBlocks = dataBitmap.freeCount;
+    buf->totalInodes = inodeBitmap.size;
+    buf->freeInodes = inodeBitmap.freeCount;
 
     return 0;
 }
 
 int fs_ls() {
-    /* Recupera o inode do diretório atual */
-    Inode* inode = find_inode(superblock->workingDirectory);
+    /* Lista o diretório atual em lotes de READDIR_BATCH entradas, sem carregá-lo inteiro na memória */
+    DirectoryItem entries[READDIR_BATCH];
+    int dd = fs_opendir(".");
+
+    if(dd == -1)
+        return -1;
+
+    int count;
 
-    /* Recupera a lista de diretórios dentro do diretório atual */
-    DirectoryItem* directoryItems = get_directory_items(superblock->workingDirectory);
+    while((count = fs_readdir(dd, entries, READDIR_BATCH)) > 0) {
+        /* Imprime nomes dos arquivos/diretórios */
+        for(int i = 0; i < count; i++)
+            printf("%s\n", entries[i].name);
+    }
+
+    fs_closedir(dd);
+
+    return count;
+}
 
-    /* Verifica se foi retornado uma lista de diretórios */
-    if(directoryItems == NULL)
+int fs_opendir(char* dirName) {
+    /* Recupera o item de diretório correspondente a dirName */
+    DirectoryItem* directoryItem = get_directory_item(dirName);
+
+    if(directoryItem == NULL)
         return -1;
 
-    /* Ponteiro para inode de um item de diretório */
-    Inode* itemInode;
+    int dirInodeNumber = directoryItem->inode;
+    free(directoryItem);
+
+    /* Verifica se realmente é um diretório */
+    Inode* inode = find_inode(dirInodeNumber);
+    int type = inode->type;
+    release_inode(inode);
 
-    /* Percorre a lista de diretórios */
-    for(int i = 0; i < (inode->size / sizeof(DirectoryItem)); i++) {
-        /* Busca o inode referente ao arquivo/diretório */
-        itemInode = find_inode(directoryItems[i].inode);
+    if(type != DIRECTORY)
+        return -1;
 
-        /* Imprime nomes dos arquivos/diretórios */
-        printf("%s\n", directoryItems[i].name);
+    /* Encontra uma posição livre na tabela de diretórios abertos */
+    int dd;
 
-        /* Libera memória alocada dinâmicamente */
-        free(itemInode);
+    for(dd = 0; dd < DIR_TABLE_SIZE; dd++) {
+        if(dirTable[dd] == NULL)
+            break;
     }
 
-    /* Libera memória alocada dinâmicamente */
-    free(directoryItems);
-    free(inode);
+    if(dd == DIR_TABLE_SIZE)
+        return -1;
+
+    /* O cursor guarda apenas um bloco do diretório por vez */
+    DirStream* stream = (DirStream*) malloc(sizeof(DirStream));
+    stream->inode = dirInodeNumber;
+    stream->offset = 0;
+    stream->blockIndex = -1;
+    stream->block = (char*) malloc(BLOCK_SIZE * sizeof(char));
+
+    dirTable[dd] = stream;
+
+    return dd;
+}
+
+int fs_readdir(int dd, DirectoryItem* entries, int count) {
+    /* Copia até count entradas para entries a partir do cursor e retorna quantas foram copiadas (0 no fim do diretório) */
+    if(dd < 0 || dd >= DIR_TABLE_SIZE || dirTable[dd] == NULL || count < 0)
+        return -1;
+
+    DirStream* stream = dirTable[dd];
+
+    /* O diretório foi removido enquanto estava aberto (veja fs_rmdir) */
+    if(stream->inode == -1)
+        return -1;
+
+    Inode* inode = find_inode(stream->inode);
+
+    /* O diretório pode ter sido removido enquanto estava aberto */
+    if(inode->type != DIRECTORY) {
+        release_inode(inode);
+        return -1;
+    }
+
+    int n = 0;
+
+    /* Copia os próximos registros ocupados, lendo cada bloco do diretório uma única vez */
+    while(n < count && dir_next_record(inode, &stream->offset, stream->block, &stream->blockIndex, &entries[n]) != -1)
+        n++;
+
+    /* O bloco guardado pode mudar até a próxima chamada */
+    stream->blockIndex = -1;
+
+    release_inode(inode);
+
+    return n;
+}
+
+int fs_readdir_plus(int dd, dirEntryPlus* entries, int count) {
+    /* Como fs_readdir, mas devolve cada entrada junto com as informações do seu inode */
+    if(count <= 0)
+        return fs_readdir(dd, NULL, 0);
+
+    DirectoryItem* items = (DirectoryItem*) malloc(count * sizeof(DirectoryItem));
+    int n = fs_readdir(dd, items, count);
+
+    if(n <= 0) {
+        free(items);
+        return n;
+    }
+
+    /* Ordena as entradas pelo número do inode para ler os inodes na ordem da tabela */
+    InodeRef* refs = (InodeRef*) malloc(n * sizeof(InodeRef));
+    int* numbers = (int*) malloc(n * sizeof(int));
+    Inode* entryInodes = (Inode*) malloc(n * sizeof(Inode));
+
+    for(int i = 0; i < n; i++) {
+        refs[i].inode = items[i].inode;
+        refs[i].index = i;
+    }
+
+    qsort(refs, n, sizeof(InodeRef), compare_inode_refs);
+
+    for(int i = 0; i < n; i++)
+        numbers[i] = refs[i].inode;
+
+    read_inodes(numbers, entryInodes, n);
+
+    /* Devolve as entradas na ordem do diretório */
+    for(int i = 0; i < n; i++) {
+        int index = refs[i].index;
+
+        bcopy((unsigned char*) items[index].name, (unsigned char*) entries[index].name, MAX_FILE_NAME);
+        fill_file_stat(&entryInodes[i], refs[i].inode, &entries[index].stat);
+    }
+
+    free(items);
+    free(refs);
+    free(numbers);
+    free(entryInodes);
+
+    return n;
+}
+
+int fs_closedir(int dd) {
+    if(dd < 0 || dd >= DIR_TABLE_SIZE || dirTable[dd] == NULL)
+        return -1;
+
+    free(dirTable[dd]->block);
+    free(dirTable[dd]);
+    dirTable[dd] = NULL;
 
     return 0;
-}
\ No newline at end of file
+}
@@ -1,7 +1,7 @@
 #ifndef FS_INCLUDED
 #define FS_INCLUDED
 
-#define FS_SIZE 2048
+#define DEFAULT_NUMBER_OF_INODES 512
 
 #define MAGIC_NUMBER "!CFS"
 #define SUPERBLOCK_BLOCK_NUMBER 0
@@ -9,10 +9,22 @@
 #define NUMBER_OF_DATA_BLOCKS superblock->numberOfDataBlocks
 #define I_MAP_BLOCK superblock->iMapStart
 #define D_MAP_BLOCK superblock->dMapStart
+#define I_MAP_BLOCKS superblock->iMapBlocks
+#define D_MAP_BLOCKS superblock->dMapBlocks
+#define BLOCKS_PER_GROUP superblock->blocksPerGroup
+#define INODES_PER_GROUP superblock->inodesPerGroup
 #define INODE_START superblock->inodeStart
 #define DATA_BLOCK_START superblock->dataBlockStart
 #define ROOT_DIRECTORY_INODE superblock->workingDirectory
+#define ROOT_INODE 0
 #define FD_TABLE_SIZE superblock->fdTableSize
+#define FD_TABLE_DEFAULT_SIZE 256
+#define FD_MAP_READ_AHEAD 64      /* blocos traduzidos além do pedido quando o mapa de um descritor não os tem */
+#define DIR_TABLE_SIZE 16
+#define READDIR_BATCH 16
+#define NUM_DIRECT 8
+#define ADDRESSES_PER_BLOCK ((int) (BLOCK_SIZE / sizeof(int)))
+#define MAX_FILE_BLOCKS (NUM_DIRECT + ADDRESSES_PER_BLOCK + ADDRESSES_PER_BLOCK * ADDRESSES_PER_BLOCK + ADDRESSES_PER_BLOCK * ADDRESSES_PER_BLOCK * ADDRESSES_PER_BLOCK)
 #define I_MAP_SIZE ((int) ceil((double) NUMBER_OF_INODES / 8))
 #define D_MAP_SIZE ((int) ceil((double) NUMBER_OF_DATA_BLOCKS / 8))
 
@@ -29,6 +41,7 @@ int fs_cd( char *dirName);
 int fs_link( char *old_fileName, char *new_fileName);
 int fs_unlink( char *fileName, ...);
 int fs_stat( char *fileName, fileStat *buf);
+int fs_sync( void);
 
 #define MAX_FILE_NAME 32
 #define MAX_PATH_NAME 256  // This is the maximum supported "full" path len, eg: /foo/bar/test.txt, rather than the maximum individual filename len.
@@ -45,20 +58,125 @@ typedef struct __attribute__((packed)) {
     int inodeStart;
     int dataBlockStart;
     int fdTableSize;
+    int blockSizeBits;
+    int inodeFormat;
+    int iMapBlocks;
+    int dMapBlocks;
+    int blocksPerGroup;
+    int inodesPerGroup;
+    int dirFormat;
+    int pointerLayout;
 } Superblock;
 
+/* Disposição dos ponteiros no formato INODE_FORMAT_POINTERS */
+#define POINTER_LAYOUT_DIRECT10 0   /* 10 ponteiros diretos e um indireto simples, no lugar do ponteiro triplo atual */
+#define POINTER_LAYOUT_INDIRECT3 1  /* NUM_DIRECT ponteiros diretos e indiretos simples, duplo e triplo */
+
+#define LEGACY_NUM_DIRECT 10
+
+/* Formatos das entradas de diretório */
+#define DIR_FORMAT_FIXED 0          /* DirectoryItem de tamanho fixo, em sequência */
+#define DIR_FORMAT_RECORDS 1        /* DirectoryRecord de tamanho variável dentro de cada bloco */
+
+/* Formatos de mapeamento dos blocos de dados nos inodes */
+#define INODE_FORMAT_POINTERS 0     /* ponteiros diretos e indiretos simples, duplos e triplos */
+#define INODE_FORMAT_EXTENTS 1      /* extents (início, tamanho) em uma árvore */
+
+/* Sequência de blocos contíguos: os blocos logical..logical+length-1 do arquivo
+   ficam nos blocos start..start+length-1 do disco. Nos nós internos da árvore
+   de extents, start é o bloco do nó filho e length não é usado. */
+typedef struct __attribute__((packed)) {
+    int logical;
+    int start;
+    int length;
+} Extent;
+
+typedef struct __attribute__((packed)) {
+    short numEntries;
+    short depth;        /* 0 nas folhas (entradas são extents) */
+} ExtentHeader;
+
+#define INODE_EXTENTS 3
+
+/* Flags do inode */
+#define INODE_FLAG_INLINE 1         /* os dados do arquivo ficam no próprio inode, no lugar do mapeamento */
+
+/* Bytes de dados que cabem no inode, no espaço dos ponteiros */
+#define INODE_INLINE_SIZE ((NUM_DIRECT + 3) * (int) sizeof(int))
+
 typedef struct __attribute__((packed)) {
-    int type;
+    short type;
+    short flags;        /* INODE_FLAG_*; ocupa a metade do antigo campo type, sempre zerada em discos antigos */
     int size;
     int linkCount;
-    int direct[10];
-    int singleIndirect;
+    union {
+        struct __attribute__((packed)) {
+            int direct[NUM_DIRECT];
+            int singleIndirect;
+            int doubleIndirect;
+            int tripleIndirect;
+        };
+        /* Raiz da árvore de extents (INODE_FORMAT_EXTENTS) */
+        struct __attribute__((packed)) {
+            ExtentHeader extentHeader;
+            Extent extents[INODE_EXTENTS];
+            int dirIndex;       /* diretórios: primeiro bloco do índice hash (<= 0 se não houver) */
+        };
+        /* Dados de arquivos pequenos (INODE_FLAG_INLINE) */
+        char inlineData[INODE_INLINE_SIZE];
+    };
 } Inode;
 
+/* Nó da árvore de extents: ocupa um bloco inteiro */
+typedef struct __attribute__((packed)) {
+    ExtentHeader header;
+    Extent entries[0];
+} ExtentNode;
+
+#define EXTENT_NODE_ENTRIES ((int) ((BLOCK_SIZE - sizeof(ExtentHeader)) / sizeof(Extent)))
+
+/* Índice hash de um diretório: o primeiro bloco tem o cabeçalho e a lista das
+   sequências de blocos (runs) que formam o índice, e os baldes começam no
+   segundo bloco. Os baldes têm 8 bytes, por isso nunca ficam divididos entre
+   dois blocos. Índices com DIR_INDEX_MAGIC_CONTIGUOUS, de versões anteriores,
+   ocupam uma única sequência com os baldes logo depois do cabeçalho. */
+#define DIR_INDEX_MAGIC 0x44495852
+#define DIR_INDEX_MAGIC_CONTIGUOUS 0x44495848
+
+typedef struct __attribute__((packed)) {
+    int magic;
+    int numBlocks;
+    int numBuckets;     /* potência de 2 */
+    int numEntries;
+    int numRuns;
+} DirIndexHeader;
+
+typedef struct __attribute__((packed)) {
+    int start;          /* primeiro bloco do disco da sequência */
+    int length;
+} DirIndexRun;
+
+#define DIR_INDEX_MAX_RUNS ((int) ((BLOCK_SIZE - sizeof(DirIndexHeader)) / sizeof(DirIndexRun)))
+
 typedef struct __attribute__((packed)) {
-    int singleIndirect[128];
-} AddressBlock;
+    unsigned int hash;
+    int position;       /* posição em bytes do registro no diretório (-1 se o balde está vazio) */
+} DirIndexBucket;
 
+/* Registro de uma entrada de diretório no disco, seguido de nameLength bytes
+   do nome (sem o terminador). Os registros de um bloco formam uma sequência
+   que cobre o bloco inteiro: length inclui o espaço livre depois do nome, e um
+   registro nunca atravessa o fim do bloco. */
+typedef struct __attribute__((packed)) {
+    int inode;                  /* -1 se o registro está livre */
+    unsigned short length;      /* bytes até o próximo registro do bloco */
+    unsigned char nameLength;
+    unsigned char fileType;     /* DIRECTORY ou FILE_TYPE */
+} DirectoryRecord;
+
+#define DIR_RECORD_SIZE(nameLength) ((int) ((sizeof(DirectoryRecord) + (nameLength) + 3) & ~3))
+
+/* Entrada de diretório em memória */
 typedef struct __attribute__((packed)) {
     char name[MAX_FILE_NAME];
     int inode;
@@ -71,6 +189,55 @@ typedef struct __attribute__((packed)) {
     int offset;
     int mode;
     int wasTouched;
+    Inode* pinnedInode;     /* entrada da cache de inodes emprestada enquanto o descritor está aberto */
+    int* blockMap;          /* blocos do disco já traduzidos, por bloco do arquivo (0: ainda não traduzido) */
+    int mapSize;
 } File;
 
-int fs_ls();
\ No newline at end of file
+typedef struct {
+    int inode;          /* inode do diretório sendo lido */
+    int offset;         /* posição em bytes do próximo registro a ser lido */
+    int blockIndex;     /* bloco do diretório guardado em block (-1: nenhum) */
+    char* block;
+} DirStream;
+
+typedef struct {
+    int blockSize;      /* tamanho do bloco em bytes: 512, 1024, 2048 ou 4096 */
+    int inodeFormat;    /* INODE_FORMAT_POINTERS ou INODE_FORMAT_EXTENTS */
+    int numBlocks;      /* tamanho da imagem em blocos (0: FS_SIZE) */
+    int bytesPerInode;  /* bytes da imagem por inode (0: DEFAULT_NUMBER_OF_INODES inodes) */
+    int blocksPerGroup; /* blocos de dados por grupo (0: os bits de um bloco do mapa) */
+    int fdTableSize;    /* descritores de arquivos abertos ao mesmo tempo (0: FD_TABLE_DEFAULT_SIZE) */
+} MkfsOptions;
+
+int fs_mkfs_with(MkfsOptions* options);
+
+typedef struct {
+    int blockSize;      /* tamanho do bloco em bytes */
+    int totalBlocks;    /* quantidade de blocos de dados */
+    int freeBlocks;     /* quantidade de blocos de dados livres */
+    int totalInodes;    /* quantidade de inodes */
+    int freeInodes;     /* quantidade de inodes livres */
+} fsStat;
+
+int fs_statfs(fsStat* buf);
+
+typedef struct {
+    int hits;           /* buscas de nomes resolvidas por uma entrada da cache */
+    int negativeHits;   /* buscas resolvidas por uma entrada negativa (o nome não existe) */
+    int misses;         /* buscas que precisaram consultar o diretório */
+    int evictions;      /* entradas reaproveitadas pela política LRU */
+} dcacheStat;
+
+int fs_dcache_stats(dcacheStat* buf);
+int fs_ls();
+
+typedef struct {
+    char name[MAX_FILE_NAME];
+    fileStat stat;
+} dirEntryPlus;
+
+int fs_opendir(char* dirName);
+int fs_readdir(int dd, DirectoryItem* entries, int count);
+int fs_readdir_plus(int dd, dirEntryPlus* entries, int count);
+int fs_closedir(int dd);
\ No newline at end of file
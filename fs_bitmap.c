@@ -0,0 +1,306 @@
+/* Mapas de bits residentes em memória
+
+   Os mapas de bits dos inodes e dos blocos de dados são carregados uma única
+   vez na montagem do sistema de arquivos e mantidos em memória junto com a
+   quantidade de bits livres e um cursor de próxima posição (next-fit). Cada
+   alocação continua a busca a partir de onde a anterior parou, e os mapas só
+   são escritos no disco por flush_bitmaps quando foram modificados.
+
+   alloc_run reserva vários bits consecutivos de uma vez, começando em um bit
+   objetivo (normalmente o seguinte ao último bloco do arquivo) quando possível
+   e, na falta de espaço contíguo suficiente, na maior sequência livre.
+
+   Um mapa pode ocupar vários blocos consecutivos do disco; cada bloco é
+   marcado como sujo individualmente, de modo que flush_bitmaps escreve apenas
+   os blocos que mudaram.
+
+   Os dois mapas são divididos em grupos (como os grupos de blocos do ext2):
+   o grupo g é formado pelos blocos de dados g * BLOCKS_PER_GROUP em diante e
+   pelos inodes g * INODES_PER_GROUP em diante, com contadores de bits livres
+   próprios. Os inodes de arquivos novos e seus blocos ficam no grupo do
+   diretório pai, enquanto diretórios novos são espalhados pelos grupos com
+   mais espaço livre, de modo que cada diretório mantém seus arquivos próximos
+   entre si. Com a geometria padrão há um único grupo.
+
+   O bit de número b fica no byte b / 8, na posição 7 - (b % 8) (o bit mais
+   significativo de cada byte é o de menor número). */
+
+typedef struct {
+    char* bits;         /* conteúdo dos blocos do mapa de bits */
+    int block;          /* primeiro bloco do disco onde o mapa de bits é salvo */
+    int numBlocks;      /* quantidade de blocos ocupados pelo mapa */
+    int size;           /* quantidade de bits válidos */
+    int freeCount;      /* quantidade de bits livres */
+    int cursor;         /* próximo bit a partir do qual a busca começa */
+    char* dirty;        /* indica, para cada bloco, se foi modificado desde a última escrita */
+    int groupSize;      /* quantidade de bits de cada grupo */
+    int numGroups;      /* quantidade de grupos do mapa */
+    int* groupFree;     /* quantidade de bits livres de cada grupo */
+} Bitmap;
+
+Bitmap inodeBitmap;
+Bitmap dataBitmap;
+
+int bitmap_test(Bitmap* bitmap, int bitNumber) {
+    return (bitmap->bits[bitNumber / 8] >> (7 - bitNumber % 8)) & 1;
+}
+
+int bitmap_group_end(Bitmap* bitmap, int group) {
+    int end = (group + 1) * bitmap->groupSize;
+
+    return end < bitmap->size ? end : bitmap->size;
+}
+
+void bitmap_count_free(Bitmap* bitmap) {
+    bitmap->freeCount = 0;
+
+    /* Os grupos começam em bytes inteiros do mapa, por isso cada um é contado separadamente */
+    for(int g = 0; g < bitmap->numGroups; g++) {
+        int first = g * bitmap->groupSize;
+        int count = bitmap_group_end(bitmap, g) - first;
+
+        bitmap->groupFree[g] = count - bitops_popcount(&bitmap->bits[first / 8], count);
+        bitmap->freeCount += bitmap->groupFree[g];
+    }
+}
+
+void bitmap_mark_dirty(Bitmap* bitmap, int bitNumber) {
+    bitmap->dirty[bitNumber / (8 * BLOCK_SIZE)] = 1;
+}
+
+void bitmap_set(Bitmap* bitmap, int bitNumber) {
+    bitmap->bits[bitNumber / 8] |= 1 << (7 - bitNumber % 8);
+    bitmap->freeCount--;
+    bitmap->groupFree[bitNumber / bitmap->groupSize]--;
+    bitmap_mark_dirty(bitmap, bitNumber);
+}
+
+void bitmap_setup(Bitmap* bitmap, int block, int numBlocks, int size, int groupSize) {
+    /* Ocupa blocos inteiros para que o mapa possa ser escrito diretamente na cache */
+    free(bitmap->bits);
+    free(bitmap->dirty);
+    free(bitmap->groupFree);
+    bitmap->bits = (char*) malloc(numBlocks * BLOCK_SIZE * sizeof(char));
+    bitmap->dirty = (char*) malloc(numBlocks * sizeof(char));
+    bitmap->block = block;
+    bitmap->numBlocks = numBlocks;
+    bitmap->size = size;
+    bitmap->cursor = 0;
+    bitmap->groupSize = groupSize;
+    bitmap->numGroups = (size + groupSize - 1) / groupSize;
+    bitmap->groupFree = (int*) malloc(bitmap->numGroups * sizeof(int));
+
+    bzero(bitmap->dirty, numBlocks);
+}
+
+void bitmap_read(Bitmap* bitmap) {
+    /* Lê todos os blocos do mapa de bits do disco e conta os bits livres */
+    for(int i = 0; i < bitmap->numBlocks; i++)
+        bcache_read(bitmap->block + i, &bitmap->bits[i * BLOCK_SIZE]);
+
+    bitmap_count_free(bitmap);
+}
+
+void load_bitmaps() {
+    bitmap_setup(&inodeBitmap, I_MAP_BLOCK, I_MAP_BLOCKS, NUMBER_OF_INODES, INODES_PER_GROUP);
+    bitmap_setup(&dataBitmap, D_MAP_BLOCK, D_MAP_BLOCKS, NUMBER_OF_DATA_BLOCKS, BLOCKS_PER_GROUP);
+
+    bitmap_read(&inodeBitmap);
+    bitmap_read(&dataBitmap);
+}
+
+int alloc_bit(Bitmap* bitmap) {
+    /* Retorna imediatamente se não há bits livres */
+    if(bitmap->freeCount == 0)
+        return -1;
+
+    /* Procura a partir do cursor e, se não encontrar, volta ao início do mapa */
+    int bitNumber = bitops_find_free(bitmap->bits, bitmap->size, bitmap->cursor);
+
+    if(bitNumber == -1)
+        bitNumber = bitops_find_free(bitmap->bits, bitmap->size, 0);
+
+    if(bitNumber == -1)
+        return -1;
+
+    /* Marca o bit como ocupado e avança o cursor para o próximo bit */
+    bitmap_set(bitmap, bitNumber);
+    bitmap->cursor = (bitNumber + 1) % bitmap->size;
+
+    return bitNumber;
+}
+
+/* Ponto de partida das buscas no grupo: o cursor, se estiver dentro dele, ou o primeiro bit do grupo */
+int bitmap_group_goal(Bitmap* bitmap, int group) {
+    int first = group * bitmap->groupSize;
+
+    if(bitmap->cursor >= first && bitmap->cursor < bitmap_group_end(bitmap, group))
+        return bitmap->cursor;
+
+    return first;
+}
+
+int alloc_bit_in_group(Bitmap* bitmap, int group) {
+    /* Retorna imediatamente se o grupo não existe ou não tem bits livres */
+    if(group >= bitmap->numGroups || bitmap->groupFree[group] == 0)
+        return -1;
+
+    /* Procura apenas dentro do grupo, a partir do cursor e depois desde o início do grupo */
+    int end = bitmap_group_end(bitmap, group);
+    int bitNumber = bitops_find_free(bitmap->bits, end, bitmap_group_goal(bitmap, group));
+
+    if(bitNumber == -1)
+        bitNumber = bitops_find_free(bitmap->bits, end, group * bitmap->groupSize);
+
+    if(bitNumber == -1)
+        return -1;
+
+    bitmap_set(bitmap, bitNumber);
+    bitmap->cursor = (bitNumber + 1) % bitmap->size;
+
+    return bitNumber;
+}
+
+/* Quantidade de bits livres consecutivos a partir de bitNumber (limitada a max) */
+int bitmap_free_extent(Bitmap* bitmap, int bitNumber, int max) {
+    int end = bitops_find_set(bitmap->bits, bitmap->size, bitNumber);
+
+    if(end == -1)
+        end = bitmap->size;
+
+    return end - bitNumber < max ? end - bitNumber : max;
+}
+
+int alloc_run(Bitmap* bitmap, int goal, int count, int* length) {
+    /* Retorna imediatamente se não há bits livres */
+    if(bitmap->freeCount == 0 || count < 1)
+        return -1;
+
+    /* Sem objetivo válido, continua de onde a última alocação parou */
+    if(goal < 0 || goal >= bitmap->size)
+        goal = bitmap->cursor;
+
+    int first;
+    int run = 0;
+
+    /* Procura count bits livres consecutivos a partir do objetivo e, se não encontrar, desde o início */
+    first = bitops_find_free_run(bitmap->bits, bitmap->size, goal, count);
+
+    if(first == -1)
+        first = bitops_find_free_run(bitmap->bits, bitmap->size, 0, count);
+
+    if(first != -1)
+        run = count;
+
+    /* Na falta de espaço contíguo suficiente, reserva a maior sequência livre disponível (preferindo a que começa no objetivo) */
+    if(first == -1) {
+        if(!bitmap_test(bitmap, goal)) {
+            first = goal;
+            run = bitmap_free_extent(bitmap, goal, count);
+        }
+
+        for(int bit = bitops_find_free(bitmap->bits, bitmap->size, 0); bit != -1; ) {
+            int extent = bitmap_free_extent(bitmap, bit, count);
+
+            if(extent > run) {
+                first = bit;
+                run = extent;
+            }
+
+            bit = bitops_find_free(bitmap->bits, bitmap->size, bit + extent);
+        }
+    }
+
+    if(first == -1)
+        return -1;
+
+    /* Marca os bits como ocupados e avança o cursor para depois da sequência */
+    for(int bit = first; bit < first + run; bit++)
+        bitmap_set(bitmap, bit);
+
+    bitmap->cursor = (first + run) % bitmap->size;
+
+    *length = run;
+
+    return first;
+}
+
+void free_bit(Bitmap* bitmap, int bitNumber) {
+    /* Ignora números inválidos e bits que já estão livres */
+    if(bitNumber < 0 || bitNumber >= bitmap->size || !bitmap_test(bitmap, bitNumber))
+        return;
+
+    bitmap->bits[bitNumber / 8] &= ~(1 << (7 - bitNumber % 8));
+    bitmap->freeCount++;
+    bitmap->groupFree[bitNumber / bitmap->groupSize]++;
+    bitmap_mark_dirty(bitmap, bitNumber);
+}
+
+int alloc_inode(int parentInodeNumber, int isDirectory) {
+    int numGroups = dataBitmap.numGroups;
+    int parentGroup = parentInodeNumber / inodeBitmap.groupSize;
+    int group = parentGroup;
+
+    /* Diretórios vão para o grupo, com pelo menos a média de inodes livres, que tem mais blocos livres */
+    if(isDirectory) {
+        int average = inodeBitmap.freeCount / numGroups;
+        int best = -1;
+
+        for(int i = 1; i < numGroups + 1; i++) {
+            int g = (parentGroup + i) % numGroups;
+
+            if(g >= inodeBitmap.numGroups || inodeBitmap.groupFree[g] == 0 || inodeBitmap.groupFree[g] < average)
+                continue;
+
+            if(best == -1 || dataBitmap.groupFree[g] > dataBitmap.groupFree[best])
+                best = g;
+        }
+
+        if(best != -1)
+            group = best;
+    }
+
+    /* Usa o grupo escolhido e, se estiver cheio, os grupos seguintes */
+    for(int i = 0; i < numGroups; i++) {
+        int inodeNumber = alloc_bit_in_group(&inodeBitmap, (group + i) % numGroups);
+
+        if(inodeNumber != -1)
+            return inodeNumber;
+    }
+
+    return -1;
+}
+
+int group_data_goal(int inodeNumber) {
+    /* Os blocos de dados de um inode começam a ser procurados no seu grupo */
+    return bitmap_group_goal(&dataBitmap, inodeNumber / inodeBitmap.groupSize);
+}
+
+void format_bitmaps() {
+    bitmap_setup(&inodeBitmap, I_MAP_BLOCK, I_MAP_BLOCKS, NUMBER_OF_INODES, INODES_PER_GROUP);
+    bitmap_setup(&dataBitmap, D_MAP_BLOCK, D_MAP_BLOCKS, NUMBER_OF_DATA_BLOCKS, BLOCKS_PER_GROUP);
+
+    /* Mapas de bits vazios, exceto pelo inode do diretório raiz (o disco recém truncado já lê blocos zerados) */
+    bzero(inodeBitmap.bits, inodeBitmap.numBlocks * BLOCK_SIZE);
+    bzero(dataBitmap.bits, dataBitmap.numBlocks * BLOCK_SIZE);
+
+    bitmap_count_free(&inodeBitmap);
+    bitmap_count_free(&dataBitmap);
+
+    alloc_bit(&inodeBitmap);
+}
+
+void bitmap_flush(Bitmap* bitmap) {
+    /* Escreve na cache apenas os blocos do mapa de bits que foram modificados */
+    for(int i = 0; bitmap->bits != NULL && i < bitmap->numBlocks; i++) {
+        if(bitmap->dirty[i]) {
+            bcache_write(bitmap->block + i, &bitmap->bits[i * BLOCK_SIZE]);
+            bitmap->dirty[i] = 0;
+        }
+    }
+}
+
+void flush_bitmaps() {
+    bitmap_flush(&inodeBitmap);
+    bitmap_flush(&dataBitmap);
+}
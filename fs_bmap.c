@@ -0,0 +1,948 @@
+/* Mapeamento dos blocos dos arquivos
+
+   Traduz os blocos de um arquivo (0, 1, 2, ...) para blocos do disco nos dois
+   formatos de inode que podem ser escolhidos no mkfs:
+
+   - INODE_FORMAT_POINTERS: NUM_DIRECT ponteiros diretos e ponteiros para
+     árvores de blocos indiretos simples, duplos e triplos, cujos blocos só
+     são alocados quando algum bloco de dados abaixo deles é usado. Os blocos
+     indiretos lidos ficam em uma pequena cache, para que percorrer a cadeia
+     de um arquivo grande não copie blocos a cada acesso.
+   - INODE_FORMAT_EXTENTS: sequências contíguas (início, tamanho) guardadas em
+     uma árvore. A raiz, com até INODE_EXTENTS entradas, fica no próprio inode;
+     quando ela enche, seu conteúdo desce para um bloco e a árvore ganha um
+     nível. Cada nível é percorrido com busca binária.
+
+   Independentemente do formato, arquivos com até INODE_INLINE_SIZE bytes
+   guardam os dados no próprio inode (INODE_FLAG_INLINE), no espaço usado
+   pelo mapeamento, e não ocupam blocos de dados. Quando crescem além disso,
+   são promovidos para blocos normais por inline_promote; quando uma escrita
+   os reduz novamente, inline_demote traz os dados de volta para o inode.
+
+   Em todos os formatos, o tamanho guardado no inode é só o dos dados: os
+   blocos de mapeamento (indiretos ou nós da árvore) não entram nele, apenas
+   na contagem de blocos de bmap_blocks. Discos antigos, que somavam o bloco
+   indireto simples ao tamanho, são corrigidos na conversão da montagem.
+
+   Os blocos de um arquivo são alocados em ordem e sem buracos, por isso novos
+   extents só são inseridos na borda direita da árvore. O resto do sistema de
+   arquivos usa apenas as funções inode_*_size e bmap_*. */
+
+#define EXTENT_ERROR -1
+#define EXTENT_OK 0
+#define EXTENT_SPLIT 1
+
+int extents_enabled() {
+    return superblock->inodeFormat == INODE_FORMAT_EXTENTS;
+}
+
+int inode_is_inline(Inode* inode) {
+    return (inode->flags & INODE_FLAG_INLINE) != 0;
+}
+
+int inode_data_size(Inode* inode) {
+    return inode->size;
+}
+
+void inode_set_data_size(Inode* inode, int size) {
+    inode->size = size;
+}
+
+void inode_init_map(Inode* inode) {
+    if(extents_enabled()) {
+        inode->extentHeader.numEntries = 0;
+        inode->extentHeader.depth = 0;
+        inode->dirIndex = -1;
+    } else {
+        for(int i = 0; i < NUM_DIRECT; i++)
+            inode->direct[i] = -1;
+
+        inode->singleIndirect = -1;
+        inode->doubleIndirect = -1;
+        inode->tripleIndirect = -1;
+    }
+}
+
+int bmap_max_blocks(Inode* inode) {
+    /* Com extents o único limite é o tamanho do disco */
+    if(extents_enabled())
+        return NUMBER_OF_DATA_BLOCKS;
+
+    /* Diretórios param antes do nível triplo (veja dir_index_block) */
+    if(inode->type == DIRECTORY)
+        return MAX_FILE_BLOCKS - ADDRESSES_PER_BLOCK * ADDRESSES_PER_BLOCK * ADDRESSES_PER_BLOCK;
+
+    return MAX_FILE_BLOCKS;
+}
+
+int dir_index_block(Inode* inode) {
+    int block = extents_enabled() ? inode->dirIndex : inode->tripleIndirect;
+
+    /* Discos antigos com extents guardam 0 no campo */
+    return block > 0 ? block : -1;
+}
+
+void dir_set_index_block(Inode* inode, int block) {
+    if(extents_enabled())
+        inode->dirIndex = block;
+    else
+        inode->tripleIndirect = block;
+}
+
+int alloc_tree_block() {
+    int bitNumber = alloc_bit(&dataBitmap);
+
+    return bitNumber == -1 ? -1 : bitNumber + DATA_BLOCK_START;
+}
+
+/* ---------- Formato de ponteiros ---------- */
+
+#define INDIRECT_CACHE_SIZE 64
+
+typedef struct {
+    int block;          /* bloco indireto guardado na entrada (-1 se vazia) */
+    int* entries;       /* cópia dos ADDRESSES_PER_BLOCK endereços do bloco */
+} CachedIndirect;
+
+CachedIndirect indirectCache[INDIRECT_CACHE_SIZE];
+
+int* indirect_get(int block) {
+    /* Cache de mapeamento direto: cada bloco indireto só pode ocupar uma posição */
+    CachedIndirect* slot = &indirectCache[block % INDIRECT_CACHE_SIZE];
+
+    if(slot->entries == NULL)
+        slot->entries = (int*) malloc(BLOCK_SIZE);
+    else if(slot->block == block)
+        return slot->entries;
+
+    bcache_read(block, (char*) slot->entries);
+    slot->block = block;
+
+    return slot->entries;
+}
+
+void indirect_put(int block, int index, int address) {
+    int* entries = indirect_get(block);
+
+    /* Atualiza a cópia em cache e o bloco na cache de blocos */
+    entries[index] = address;
+    bcache_write(block, (char*) entries);
+}
+
+void indirect_forget(int block) {
+    CachedIndirect* slot = &indirectCache[block % INDIRECT_CACHE_SIZE];
+
+    if(slot->entries != NULL && slot->block == block)
+        slot->block = -1;
+}
+
+void invalidate_indirect_cache() {
+    /* Descarta as entradas, que dependem do tamanho do bloco */
+    for(int i = 0; i < INDIRECT_CACHE_SIZE; i++) {
+        free(indirectCache[i].entries);
+        indirectCache[i].entries = NULL;
+        indirectCache[i].block = -1;
+    }
+}
+
+int alloc_indirect_block() {
+    int block = alloc_tree_block();
+
+    if(block == -1)
+        return -1;
+
+    /* Um bloco indireto novo não aponta para nenhum bloco */
+    int* entries = indirect_get(block);
+
+    for(int i = 0; i < ADDRESSES_PER_BLOCK; i++)
+        entries[i] = -1;
+
+    bcache_write(block, (char*) entries);
+
+    return block;
+}
+
+/* Calcula em qual árvore (0 direto, 1 simples, 2 duplo, 3 triplo) está o bloco e o índice usado em cada nível dela */
+int pointers_path(int fileBlock, int offsets[]) {
+    if(fileBlock < NUM_DIRECT) {
+        offsets[0] = fileBlock;
+        return 0;
+    }
+
+    fileBlock -= NUM_DIRECT;
+
+    int span = 1;
+
+    for(int level = 1; level < 4; level++) {
+        span *= ADDRESSES_PER_BLOCK;
+
+        if(fileBlock < span) {
+            for(int l = level - 1; l >= 0; l--) {
+                offsets[l] = fileBlock % ADDRESSES_PER_BLOCK;
+                fileBlock /= ADDRESSES_PER_BLOCK;
+            }
+
+            return level;
+        }
+
+        fileBlock -= span;
+    }
+
+    return -1;
+}
+
+int pointers_root(Inode* inode, int level) {
+    if(level == 1)
+        return inode->singleIndirect;
+
+    if(level == 2)
+        return inode->doubleIndirect;
+
+    /* Diretórios não usam o nível triplo, cujo campo guarda o índice hash */
+    if(inode->type == DIRECTORY)
+        return -1;
+
+    return inode->tripleIndirect;
+}
+
+void pointers_set_root(Inode* inode, int level, int block) {
+    if(level == 1)
+        inode->singleIndirect = block;
+    else if(level == 2)
+        inode->doubleIndirect = block;
+    else
+        inode->tripleIndirect = block;
+}
+
+int pointers_lookup(Inode* inode, int fileBlock) {
+    int offsets[3];
+    int level = pointers_path(fileBlock, offsets);
+
+    if(level == -1)
+        return -1;
+
+    if(level == 0)
+        return inode->direct[offsets[0]];
+
+    /* Segue a cadeia de blocos indiretos até o bloco de dados */
+    int block = pointers_root(inode, level);
+
+    for(int l = 0; l < level && block != -1; l++)
+        block = indirect_get(block)[offsets[l]];
+
+    return block;
+}
+
+int pointers_set(Inode* inode, int fileBlock, int block) {
+    int offsets[3];
+    int level = pointers_path(fileBlock, offsets);
+
+    if(level == -1)
+        return -1;
+
+    if(level == 0) {
+        inode->direct[offsets[0]] = block;
+        return 0;
+    }
+
+    /* Aloca os blocos indiretos que ainda não existem no caminho até o bloco */
+    int parent = pointers_root(inode, level);
+
+    if(parent == -1) {
+        if((parent = alloc_indirect_block()) == -1)
+            return -1;
+
+        pointers_set_root(inode, level, parent);
+    }
+
+    for(int l = 0; l < level - 1; l++) {
+        int child = indirect_get(parent)[offsets[l]];
+
+        if(child == -1) {
+            if((child = alloc_indirect_block()) == -1)
+                return -1;
+
+            indirect_put(parent, offsets[l], child);
+        }
+
+        parent = child;
+    }
+
+    indirect_put(parent, offsets[level - 1], block);
+
+    return 0;
+}
+
+int pointers_alloc(Inode* inode, int goal, int blockStart, int blockEnd) {
+    /* O objetivo é o bloco seguinte ao último bloco já alocado do arquivo (ou goal, se não houver) */
+    int blockCount = 0;
+    int previous = blockStart > 0 ? pointers_lookup(inode, blockStart - 1) : -1;
+
+    if(previous != -1)
+        goal = previous - DATA_BLOCK_START + 1;
+
+    for(int i = blockStart; i < blockEnd + 1; ) {
+        int block = pointers_lookup(inode, i);
+
+        if(block != -1) {
+            goal = block - DATA_BLOCK_START + 1;
+            blockCount++;
+            i++;
+            continue;
+        }
+
+        /* Reserva de uma vez todos os blocos que faltam em seguida */
+        int missing = 1;
+
+        while(i + missing < blockEnd + 1 && pointers_lookup(inode, i + missing) == -1)
+            missing++;
+
+        int length;
+        int first = alloc_run(&dataBitmap, goal, missing, &length);
+
+        if(first == -1)
+            break;
+
+        int linked = 0;
+
+        while(linked < length && pointers_set(inode, i + linked, first + linked + DATA_BLOCK_START) == 0)
+            linked++;
+
+        /* Devolve os blocos que não puderam ser ligados ao arquivo por falta de espaço para blocos indiretos */
+        for(int j = linked; j < length; j++)
+            free_bit(&dataBitmap, first + j);
+
+        blockCount += linked;
+        i += linked;
+        goal = first + linked;
+
+        if(linked < length)
+            break;
+    }
+
+    return blockCount;
+}
+
+void pointers_range(Inode* inode, int blockStart, int blockEnd, int blocks[]) {
+    for(int i = blockStart; i < blockEnd + 1; i++)
+        blocks[i - blockStart] = pointers_lookup(inode, i);
+}
+
+/* Libera os blocos da árvore indireta com raiz em block, que cobre os blocos do arquivo a partir de first, mantendo os anteriores a numBlocks; retorna 1 se a árvore ficou vazia e seu bloco foi liberado */
+int pointers_free_tree(int block, int level, int first, int numBlocks) {
+    int* entries = (int*) malloc(BLOCK_SIZE);
+    int childSpan = 1;
+    int used = 0;
+
+    for(int l = 1; l < level; l++)
+        childSpan *= ADDRESSES_PER_BLOCK;
+
+    /* Trabalha em uma cópia, pois a recursão pode reaproveitar a entrada da cache */
+    bcopy((unsigned char*) indirect_get(block), (unsigned char*) entries, BLOCK_SIZE);
+
+    for(int i = 0; i < ADDRESSES_PER_BLOCK; i++) {
+        int childFirst = first + i * childSpan;
+
+        if(entries[i] == -1 || childFirst + childSpan <= numBlocks) {
+            used += entries[i] != -1;
+            continue;
+        }
+
+        if(level == 1) {
+            free_bit(&dataBitmap, entries[i] - DATA_BLOCK_START);
+            entries[i] = -1;
+        } else if(pointers_free_tree(entries[i], level - 1, childFirst, numBlocks)) {
+            entries[i] = -1;
+        } else {
+            used++;
+        }
+    }
+
+    if(used == 0) {
+        indirect_forget(block);
+        free_bit(&dataBitmap, block - DATA_BLOCK_START);
+    } else {
+        bcopy((unsigned char*) entries, (unsigned char*) indirect_get(block), BLOCK_SIZE);
+        bcache_write(block, (char*) entries);
+    }
+
+    free(entries);
+
+    return used == 0;
+}
+
+void pointers_truncate(Inode* inode, int numBlocks) {
+    /* Libera os blocos diretos a partir de numBlocks */
+    for(int i = numBlocks; i < NUM_DIRECT; i++) {
+        if(inode->direct[i] != -1) {
+            free_bit(&dataBitmap, inode->direct[i] - DATA_BLOCK_START);
+            inode->direct[i] = -1;
+        }
+    }
+
+    /* Percorre as árvores indiretas, cada uma começando depois da anterior */
+    int first = NUM_DIRECT;
+    int span = 1;
+
+    for(int level = 1; level < 4; level++) {
+        int root = pointers_root(inode, level);
+
+        span *= ADDRESSES_PER_BLOCK;
+
+        if(root != -1 && first + span > numBlocks && pointers_free_tree(root, level, first, numBlocks))
+            pointers_set_root(inode, level, -1);
+
+        first += span;
+    }
+}
+
+/* Lista em blocks os blocos de dados de um inode na disposição POINTER_LAYOUT_DIRECT10 e retorna quantos são;
+   *single recebe o bloco indireto simples (-1 se não houver). Discos antigos deixam ponteiros sem uso em -1 ou 0 */
+int pointers_legacy_blocks(Inode* inode, int blocks[], int* single) {
+    int pointers[LEGACY_NUM_DIRECT + 1];
+    int numBlocks = 0;
+
+    bcopy((unsigned char*) inode->inlineData, (unsigned char*) pointers, sizeof(pointers));
+
+    for(int i = 0; i < LEGACY_NUM_DIRECT; i++) {
+        if(pointers[i] >= DATA_BLOCK_START && pointers[i] < superblock->diskSize)
+            blocks[numBlocks++] = pointers[i];
+    }
+
+    *single = pointers[LEGACY_NUM_DIRECT] >= DATA_BLOCK_START && pointers[LEGACY_NUM_DIRECT] < superblock->diskSize ? pointers[LEGACY_NUM_DIRECT] : -1;
+
+    if(*single != -1) {
+        int* entries = indirect_get(*single);
+
+        for(int i = 0; i < ADDRESSES_PER_BLOCK && entries[i] >= DATA_BLOCK_START && entries[i] < superblock->diskSize; i++)
+            blocks[numBlocks++] = entries[i];
+    }
+
+    return numBlocks;
+}
+
+/* Quantidade de blocos indiretos usados por um arquivo de numBlocks blocos (sem buracos) */
+int pointers_indirect_count(int numBlocks) {
+    int remaining = numBlocks - NUM_DIRECT;
+    int perDouble = ADDRESSES_PER_BLOCK * ADDRESSES_PER_BLOCK;
+
+    if(remaining <= 0)
+        return 0;
+
+    /* Indireto simples */
+    if((remaining -= ADDRESSES_PER_BLOCK) <= 0)
+        return 1;
+
+    /* Indireto duplo: a raiz e um bloco para cada ADDRESSES_PER_BLOCK blocos de dados */
+    int count = 2 + ((remaining < perDouble ? remaining : perDouble) + ADDRESSES_PER_BLOCK - 1) / ADDRESSES_PER_BLOCK;
+
+    if((remaining -= perDouble) <= 0)
+        return count;
+
+    /* Indireto triplo: a raiz, os blocos do segundo nível e os do último */
+    return count + 1 + (remaining + perDouble - 1) / perDouble + (remaining + ADDRESSES_PER_BLOCK - 1) / ADDRESSES_PER_BLOCK;
+}
+
+/* ---------- Formato de extents ---------- */
+
+void extent_free_blocks(int start, int length) {
+    for(int i = 0; i < length; i++)
+        free_bit(&dataBitmap, start + i - DATA_BLOCK_START);
+}
+
+/* Índice da última entrada com logical <= fileBlock, ou -1 se não houver */
+int extent_search(Extent* entries, int numEntries, int fileBlock) {
+    int low = 0;
+    int high = numEntries - 1;
+    int found = -1;
+
+    while(low <= high) {
+        int middle = (low + high) / 2;
+
+        if(entries[middle].logical <= fileBlock) {
+            found = middle;
+            low = middle + 1;
+        } else {
+            high = middle - 1;
+        }
+    }
+
+    return found;
+}
+
+int extent_find(Inode* inode, int fileBlock, Extent* found) {
+    ExtentHeader* header = &inode->extentHeader;
+    Extent* entries = inode->extents;
+    char* node = NULL;
+    int result = -1;
+
+    /* Desce da raiz até a folha que pode conter fileBlock */
+    for(;;) {
+        int i = extent_search(entries, header->numEntries, fileBlock);
+
+        if(i == -1)
+            break;
+
+        if(header->depth == 0) {
+            if(fileBlock < entries[i].logical + entries[i].length) {
+                *found = entries[i];
+                result = 0;
+            }
+
+            break;
+        }
+
+        if(node == NULL)
+            node = (char*) malloc(BLOCK_SIZE * sizeof(char));
+
+        bcache_read(entries[i].start, node);
+        header = &((ExtentNode*) node)->header;
+        entries = ((ExtentNode*) node)->entries;
+    }
+
+    free(node);
+
+    return result;
+}
+
+/* Último extent do arquivo (seguindo sempre a entrada mais à direita) */
+int extent_last(Inode* inode, Extent* last) {
+    ExtentHeader* header = &inode->extentHeader;
+    Extent* entries = inode->extents;
+    char* node = NULL;
+    int result = -1;
+
+    while(header->numEntries > 0) {
+        if(header->depth == 0) {
+            *last = entries[header->numEntries - 1];
+            result = 0;
+            break;
+        }
+
+        if(node == NULL)
+            node = (char*) malloc(BLOCK_SIZE * sizeof(char));
+
+        bcache_read(entries[header->numEntries - 1].start, node);
+        header = &((ExtentNode*) node)->header;
+        entries = ((ExtentNode*) node)->entries;
+    }
+
+    free(node);
+
+    return result;
+}
+
+int extent_mapped_blocks(Inode* inode) {
+    Extent last;
+
+    if(extent_last(inode, &last) != 0)
+        return 0;
+
+    return last.logical + last.length;
+}
+
+int extent_count_nodes(int block, int depth) {
+    /* Conta um nó e, nos níveis internos, todos os nós abaixo dele */
+    int count = 1;
+
+    if(depth > 0) {
+        ExtentNode* node = (ExtentNode*) malloc(BLOCK_SIZE);
+
+        bcache_read(block, (char*) node);
+
+        for(int i = 0; i < node->header.numEntries; i++)
+            count += extent_count_nodes(node->entries[i].start, depth - 1);
+
+        free(node);
+    }
+
+    return count;
+}
+
+void extent_free_nodes(int block, int depth) {
+    /* Libera um nó e, nos níveis internos, todos os nós abaixo dele */
+    if(depth > 0) {
+        ExtentNode* node = (ExtentNode*) malloc(BLOCK_SIZE);
+
+        bcache_read(block, (char*) node);
+
+        for(int i = 0; i < node->header.numEntries; i++)
+            extent_free_nodes(node->entries[i].start, depth - 1);
+
+        free(node);
+    }
+
+    extent_free_blocks(block, 1);
+}
+
+/* Cria um nó irmão à direita contendo apenas entry e devolve em split a entrada que aponta para ele */
+int extent_new_sibling(int depth, Extent* entry, Extent* split) {
+    int block = alloc_tree_block();
+
+    if(block == -1)
+        return EXTENT_ERROR;
+
+    ExtentNode* node = (ExtentNode*) malloc(BLOCK_SIZE);
+    bzero((char*) node, BLOCK_SIZE);
+
+    node->header.numEntries = 1;
+    node->header.depth = depth;
+    node->entries[0] = *entry;
+
+    bcache_write(block, (char*) node);
+    free(node);
+
+    split->logical = entry->logical;
+    split->start = block;
+    split->length = 0;
+
+    return EXTENT_SPLIT;
+}
+
+/* Indica se extent continua last, tanto no arquivo quanto no disco */
+int extent_contiguous(Extent* last, Extent* extent) {
+    return last->logical + last->length == extent->logical && last->start + last->length == extent->start;
+}
+
+int extent_insert(ExtentHeader* header, Extent* entries, int capacity, Extent* extent, Extent* split) {
+    int n = header->numEntries;
+
+    if(header->depth == 0) {
+        /* Estende o último extent quando os blocos continuam contíguos no arquivo e no disco */
+        if(n > 0 && extent_contiguous(&entries[n - 1], extent)) {
+            entries[n - 1].length += extent->length;
+            return EXTENT_OK;
+        }
+
+        if(n < capacity) {
+            entries[n] = *extent;
+            header->numEntries++;
+            return EXTENT_OK;
+        }
+
+        return extent_new_sibling(0, extent, split);
+    }
+
+    /* Insere no filho mais à direita */
+    int childBlock = entries[n - 1].start;
+    ExtentNode* child = (ExtentNode*) malloc(BLOCK_SIZE);
+    Extent childSplit;
+
+    bcache_read(childBlock, (char*) child);
+
+    int result = extent_insert(&child->header, child->entries, EXTENT_NODE_ENTRIES, extent, &childSplit);
+
+    if(result == EXTENT_OK)
+        bcache_write(childBlock, (char*) child);
+
+    free(child);
+
+    if(result != EXTENT_SPLIT)
+        return result;
+
+    /* O filho encheu e ganhou um irmão, que passa a ser apontado por este nó */
+    if(n < capacity) {
+        entries[n] = childSplit;
+        header->numEntries++;
+        return EXTENT_OK;
+    }
+
+    result = extent_new_sibling(header->depth, &childSplit, split);
+
+    if(result == EXTENT_ERROR)
+        extent_free_nodes(childSplit.start, header->depth - 1);
+
+    return result;
+}
+
+/* Move o conteúdo da raiz para um novo bloco e faz a raiz apontar para ele e, se houver, para extra, o irmão
+   criado quando a raiz encheu (extra está no mesmo nível do conteúdo movido, não abaixo dele) */
+int extent_push_down(Inode* inode, Extent* extra) {
+    int block = alloc_tree_block();
+
+    if(block == -1)
+        return EXTENT_ERROR;
+
+    ExtentNode* node = (ExtentNode*) malloc(BLOCK_SIZE);
+    bzero((char*) node, BLOCK_SIZE);
+
+    node->header = inode->extentHeader;
+    bcopy((unsigned char*) inode->extents, (unsigned char*) node->entries, INODE_EXTENTS * sizeof(Extent));
+
+    bcache_write(block, (char*) node);
+
+    /* A árvore ganha um nível e a raiz passa a ter uma entrada para o bloco e outra para o irmão */
+    inode->extentHeader.depth++;
+    inode->extentHeader.numEntries = 1;
+    inode->extents[0].logical = node->entries[0].logical;
+    inode->extents[0].start = block;
+    inode->extents[0].length = 0;
+
+    if(extra != NULL)
+        inode->extents[inode->extentHeader.numEntries++] = *extra;
+
+    free(node);
+
+    return EXTENT_OK;
+}
+
+int extent_append(Inode* inode, Extent* extent) {
+    ExtentHeader* root = &inode->extentHeader;
+
+    /* Uma raiz folha cheia desce antes da inserção, para que o novo extent fique no mesmo bloco que os anteriores */
+    if(root->depth == 0 && root->numEntries == INODE_EXTENTS && !extent_contiguous(&inode->extents[INODE_EXTENTS - 1], extent)) {
+        if(extent_push_down(inode, NULL) != EXTENT_OK)
+            return EXTENT_ERROR;
+    }
+
+    Extent split;
+    int result = extent_insert(root, inode->extents, INODE_EXTENTS, extent, &split);
+
+    if(result != EXTENT_SPLIT)
+        return result;
+
+    /* A raiz de índices está cheia: ela desce e a nova raiz aponta para ela e para o novo irmão */
+    if(extent_push_down(inode, &split) != EXTENT_OK) {
+        extent_free_nodes(split.start, root->depth);
+        return EXTENT_ERROR;
+    }
+
+    return EXTENT_OK;
+}
+
+/* Copia os extents da subárvore para o fim de list, liberando os blocos dos nós percorridos */
+void extent_unload(ExtentHeader* header, Extent* entries, Extent** list, int* count, int* capacity) {
+    for(int i = 0; i < header->numEntries; i++) {
+        if(header->depth == 0) {
+            if(*count == *capacity) {
+                *capacity = *capacity * 2 + INODE_EXTENTS;
+                *list = (Extent*) realloc(*list, *capacity * sizeof(Extent));
+            }
+
+            (*list)[(*count)++] = entries[i];
+        } else {
+            ExtentNode* child = (ExtentNode*) malloc(BLOCK_SIZE);
+
+            bcache_read(entries[i].start, (char*) child);
+            extent_unload(&child->header, child->entries, list, count, capacity);
+            extent_free_blocks(entries[i].start, 1);
+
+            free(child);
+        }
+    }
+}
+
+int extents_alloc(Inode* inode, int goal, int blockStart, int blockEnd) {
+    Extent last;
+    int mapped = 0;
+
+    /* Continua a partir do último bloco do arquivo, no disco e no arquivo */
+    if(extent_last(inode, &last) == 0) {
+        mapped = last.logical + last.length;
+        goal = last.start + last.length - DATA_BLOCK_START;
+    }
+
+    /* Não deixa buracos: só é possível escrever até o fim atual do arquivo */
+    if(blockStart > mapped)
+        return 0;
+
+    while(mapped < blockEnd + 1) {
+        int length;
+        int first = alloc_run(&dataBitmap, goal, blockEnd + 1 - mapped, &length);
+
+        if(first == -1)
+            break;
+
+        Extent extent;
+        extent.logical = mapped;
+        extent.start = first + DATA_BLOCK_START;
+        extent.length = length;
+
+        /* Devolve a sequência se não houver espaço para os nós da árvore */
+        if(extent_append(inode, &extent) != EXTENT_OK) {
+            extent_free_blocks(extent.start, length);
+            break;
+        }
+
+        mapped += length;
+        goal = first + length;
+    }
+
+    return mapped - blockStart < blockEnd - blockStart + 1 ? mapped - blockStart : blockEnd - blockStart + 1;
+}
+
+void extents_range(Inode* inode, int blockStart, int blockEnd, int blocks[]) {
+    for(int i = blockStart; i < blockEnd + 1; ) {
+        Extent extent;
+
+        if(extent_find(inode, i, &extent) != 0) {
+            blocks[i - blockStart] = -1;
+            i++;
+            continue;
+        }
+
+        /* Um único extent resolve todos os blocos contíguos que ele cobre */
+        for(; i < blockEnd + 1 && i < extent.logical + extent.length; i++)
+            blocks[i - blockStart] = extent.start + i - extent.logical;
+    }
+}
+
+void extents_truncate(Inode* inode, int numBlocks) {
+    if(extent_mapped_blocks(inode) <= numBlocks)
+        return;
+
+    Extent* list = NULL;
+    int count = 0;
+    int capacity = 0;
+
+    /* Desmonta a árvore e a reconstrói apenas com os blocos mantidos */
+    extent_unload(&inode->extentHeader, inode->extents, &list, &count, &capacity);
+
+    inode->extentHeader.numEntries = 0;
+    inode->extentHeader.depth = 0;
+
+    for(int i = 0; i < count; i++) {
+        if(list[i].logical >= numBlocks) {
+            extent_free_blocks(list[i].start, list[i].length);
+            continue;
+        }
+
+        if(list[i].logical + list[i].length > numBlocks) {
+            int kept = numBlocks - list[i].logical;
+
+            extent_free_blocks(list[i].start + kept, list[i].length - kept);
+            list[i].length = kept;
+        }
+
+        extent_append(inode, &list[i]);
+    }
+
+    free(list);
+}
+
+/* ---------- Interface usada pelo sistema de arquivos ---------- */
+
+void bmap_range(Inode* inode, int blockStart, int blockEnd, int blocks[]) {
+    /* Preenche blocks com os blocos do disco de blockStart a blockEnd (-1 se não alocado) */
+    if(inode_is_inline(inode)) {
+        for(int i = blockStart; i < blockEnd + 1; i++)
+            blocks[i - blockStart] = -1;
+    } else if(extents_enabled())
+        extents_range(inode, blockStart, blockEnd, blocks);
+    else
+        pointers_range(inode, blockStart, blockEnd, blocks);
+}
+
+int bmap(Inode* inode, int fileBlock) {
+    int block;
+
+    bmap_range(inode, fileBlock, fileBlock, &block);
+
+    return block;
+}
+
+int bmap_alloc(Inode* inode, int inodeNumber, int blockStart, int blockEnd) {
+    /* Aloca os blocos que faltam de blockStart a blockEnd e retorna quantos blocos a partir de blockStart podem ser usados */
+    int goal = group_data_goal(inodeNumber);
+    int blockCount;
+
+    /* Arquivos com dados embutidos precisam ser promovidos antes de receber blocos */
+    if(inode_is_inline(inode))
+        return 0;
+
+    if(blockEnd > bmap_max_blocks(inode) - 1)
+        blockEnd = bmap_max_blocks(inode) - 1;
+
+    if(blockStart > blockEnd)
+        return 0;
+
+    if(extents_enabled())
+        blockCount = extents_alloc(inode, goal, blockStart, blockEnd);
+    else
+        blockCount = pointers_alloc(inode, goal, blockStart, blockEnd);
+
+    return blockCount;
+}
+
+void bmap_truncate(Inode* inode, int numBlocks) {
+    /* Libera os blocos do arquivo a partir de numBlocks, junto com os blocos de mapeamento que ficarem sem uso */
+    if(inode_is_inline(inode))
+        return;
+
+    if(extents_enabled())
+        extents_truncate(inode, numBlocks);
+    else
+        pointers_truncate(inode, numBlocks);
+}
+
+int bmap_blocks(Inode* inode) {
+    /* Blocos ocupados pelo arquivo: os de dados e todos os de mapeamento (indiretos ou nós internos e folhas da árvore) */
+    int numBlocks = (inode_data_size(inode) + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+    if(inode_is_inline(inode))
+        return 0;
+
+    if(!extents_enabled())
+        return numBlocks + pointers_indirect_count(numBlocks);
+
+    for(int i = 0; inode->extentHeader.depth > 0 && i < inode->extentHeader.numEntries; i++)
+        numBlocks += extent_count_nodes(inode->extents[i].start, inode->extentHeader.depth - 1);
+
+    return numBlocks;
+}
+
+/* ---------- Dados embutidos no inode ---------- */
+
+int inline_promote(Inode* inode, int inodeNumber) {
+    /* Guarda os dados embutidos antes de o espaço voltar a ser usado pelo mapeamento */
+    char data[INODE_INLINE_SIZE];
+    int size = inode->size;
+
+    bcopy((unsigned char*) inode->inlineData, (unsigned char*) data, size);
+
+    inode->flags &= ~INODE_FLAG_INLINE;
+    inode_init_map(inode);
+    inode->size = 0;
+
+    /* Copia os dados para o primeiro bloco do arquivo, desfazendo a promoção se não houver bloco livre */
+    if(size > 0) {
+        if(bmap_alloc(inode, inodeNumber, 0, 0) == 0) {
+            inode->flags |= INODE_FLAG_INLINE;
+            bcopy((unsigned char*) data, (unsigned char*) inode->inlineData, size);
+            inode->size = size;
+            return -1;
+        }
+
+        char* buffer = (char*) malloc(BLOCK_SIZE * sizeof(char));
+
+        bzero(buffer, BLOCK_SIZE);
+        bcopy((unsigned char*) data, (unsigned char*) buffer, size);
+        bcache_write(bmap(inode, 0), buffer);
+
+        free(buffer);
+    }
+
+    inode_set_data_size(inode, size);
+
+    return 0;
+}
+
+void inline_demote(Inode* inode) {
+    /* Mantém apenas os bytes que cabem no inode e libera todos os blocos do arquivo */
+    int size = inode_data_size(inode);
+    char* buffer = (char*) malloc(BLOCK_SIZE * sizeof(char));
+
+    if(size > INODE_INLINE_SIZE)
+        size = INODE_INLINE_SIZE;
+
+    if(size > 0)
+        bcache_read(bmap(inode, 0), buffer);
+
+    bmap_truncate(inode, 0);
+
+    inode->flags |= INODE_FLAG_INLINE;
+    bcopy((unsigned char*) buffer, (unsigned char*) inode->inlineData, size);
+    inode->size = size;
+
+    free(buffer);
+}
@@ -0,0 +1,197 @@
+/* Cache de entradas de diretório (dentries)
+
+   Guarda o resultado das buscas de nomes: a chave é o par (inode do diretório,
+   nome) e o valor é o número do inode do item, ou -1 em uma entrada negativa,
+   que registra que o nome não existe no diretório. Buscas repetidas, como as
+   de fs_open em um arquivo muito usado, são resolvidas sem ler o diretório.
+
+   As funções que criam ou removem entradas de diretório atualizam a cache com
+   dcache_insert, e fs_rmdir descarta as entradas do diretório removido, cujo
+   número de inode pode ser reaproveitado. A cache tem DCACHE_SIZE entradas
+   reaproveitadas em ordem LRU. */
+
+#define DCACHE_SIZE 256
+#define DCACHE_HASH_SIZE 128
+
+typedef struct CachedDentry {
+    int parent;                     /* inode do diretório (-1 se a entrada está livre) */
+    char name[MAX_FILE_NAME];
+    int inode;                      /* inode do item ou -1 se o nome não existe */
+    struct CachedDentry* hashNext;
+    struct CachedDentry* lruPrev;
+    struct CachedDentry* lruNext;
+} CachedDentry;
+
+CachedDentry* dcacheHash[DCACHE_HASH_SIZE];
+CachedDentry* dcacheEntries = NULL;
+
+/* Lista LRU de todas as entradas: a cabeça é a mais recente e a cauda é a próxima a ser reaproveitada */
+CachedDentry* dcacheLruHead = NULL;
+CachedDentry* dcacheLruTail = NULL;
+
+dcacheStat dcacheStats;
+
+unsigned int dcache_hash(int parent, char* name) {
+    return (dir_hash(name) ^ (unsigned int) parent * 2654435761u) % DCACHE_HASH_SIZE;
+}
+
+void dcache_lru_remove(CachedDentry* entry) {
+    if(entry->lruPrev != NULL)
+        entry->lruPrev->lruNext = entry->lruNext;
+    else
+        dcacheLruHead = entry->lruNext;
+
+    if(entry->lruNext != NULL)
+        entry->lruNext->lruPrev = entry->lruPrev;
+    else
+        dcacheLruTail = entry->lruPrev;
+
+    entry->lruPrev = NULL;
+    entry->lruNext = NULL;
+}
+
+void dcache_lru_push_front(CachedDentry* entry) {
+    entry->lruPrev = NULL;
+    entry->lruNext = dcacheLruHead;
+
+    if(dcacheLruHead != NULL)
+        dcacheLruHead->lruPrev = entry;
+    else
+        dcacheLruTail = entry;
+
+    dcacheLruHead = entry;
+}
+
+void dcache_lru_push_back(CachedDentry* entry) {
+    entry->lruNext = NULL;
+    entry->lruPrev = dcacheLruTail;
+
+    if(dcacheLruTail != NULL)
+        dcacheLruTail->lruNext = entry;
+    else
+        dcacheLruHead = entry;
+
+    dcacheLruTail = entry;
+}
+
+void dcache_hash_remove(CachedDentry* entry) {
+    CachedDentry** link = &dcacheHash[dcache_hash(entry->parent, entry->name)];
+
+    while(*link != NULL && *link != entry)
+        link = &(*link)->hashNext;
+
+    if(*link == entry)
+        *link = entry->hashNext;
+
+    entry->hashNext = NULL;
+}
+
+void dcache_init() {
+    /* Todas as entradas começam livres, no fim da lista LRU */
+    dcacheEntries = (CachedDentry*) malloc(DCACHE_SIZE * sizeof(CachedDentry));
+
+    for(int i = 0; i < DCACHE_SIZE; i++) {
+        dcacheEntries[i].parent = -1;
+        dcacheEntries[i].hashNext = NULL;
+        dcache_lru_push_back(&dcacheEntries[i]);
+    }
+}
+
+CachedDentry* dcache_find(int parent, char* name) {
+    /* Nomes que não cabem em uma entrada de diretório não são guardados */
+    if(dcacheEntries == NULL || strlen(name) >= MAX_FILE_NAME)
+        return NULL;
+
+    CachedDentry* entry = dcacheHash[dcache_hash(parent, name)];
+
+    while(entry != NULL && (entry->parent != parent || !same_string(entry->name, name)))
+        entry = entry->hashNext;
+
+    return entry;
+}
+
+int dcache_lookup(int parent, char* name, int* inodeNumber) {
+    /* Retorna 1 e o inode do item (ou -1 se o nome não existe) quando a resposta está na cache */
+    CachedDentry* entry = dcache_find(parent, name);
+
+    if(entry == NULL) {
+        dcacheStats.misses++;
+        return 0;
+    }
+
+    if(entry->inode == -1)
+        dcacheStats.negativeHits++;
+    else
+        dcacheStats.hits++;
+
+    dcache_lru_remove(entry);
+    dcache_lru_push_front(entry);
+
+    *inodeNumber = entry->inode;
+
+    return 1;
+}
+
+void dcache_insert(int parent, char* name, int inodeNumber) {
+    if(dcacheEntries == NULL)
+        dcache_init();
+
+    if(strlen(name) >= MAX_FILE_NAME)
+        return;
+
+    CachedDentry* entry = dcache_find(parent, name);
+
+    /* Reaproveita a entrada menos usada quando o nome ainda não está na cache */
+    if(entry == NULL) {
+        entry = dcacheLruTail;
+
+        if(entry->parent != -1) {
+            dcache_hash_remove(entry);
+            dcacheStats.evictions++;
+        }
+
+        entry->parent = parent;
+        bzero(entry->name, MAX_FILE_NAME);
+        bcopy((unsigned char*) name, (unsigned char*) entry->name, strlen(name) + 1);
+
+        unsigned int bucket = dcache_hash(parent, name);
+        entry->hashNext = dcacheHash[bucket];
+        dcacheHash[bucket] = entry;
+    }
+
+    entry->inode = inodeNumber;
+
+    dcache_lru_remove(entry);
+    dcache_lru_push_front(entry);
+}
+
+void dcache_release(CachedDentry* entry) {
+    /* Libera a entrada e a coloca no fim da lista LRU para ser reaproveitada primeiro */
+    dcache_hash_remove(entry);
+    entry->parent = -1;
+
+    dcache_lru_remove(entry);
+    dcache_lru_push_back(entry);
+}
+
+void dcache_purge_directory(int parent) {
+    /* Descarta as entradas do diretório parent, que deixou de existir */
+    for(int i = 0; dcacheEntries != NULL && i < DCACHE_SIZE; i++) {
+        if(dcacheEntries[i].parent == parent)
+            dcache_release(&dcacheEntries[i]);
+    }
+}
+
+void invalidate_dentries() {
+    /* Descarta todas as entradas (o disco será formatado) */
+    for(int i = 0; dcacheEntries != NULL && i < DCACHE_SIZE; i++) {
+        if(dcacheEntries[i].parent != -1)
+            dcache_release(&dcacheEntries[i]);
+    }
+}
+
+int fs_dcache_stats(dcacheStat* buf) {
+    *buf = dcacheStats;
+
+    return 0;
+}
@@ -0,0 +1,173 @@
+/* Registros de entradas de diretório
+
+   Cada bloco de um diretório é uma sequência de DirectoryRecord de tamanho
+   variável, semelhante ao formato do ext2: o registro guarda o tamanho do
+   nome, o tipo do item e o número do inode, e o nome ocupa apenas os bytes
+   necessários. O espaço livre de um bloco fica no fim do último registro que
+   o precede; uma remoção junta o registro ao anterior (ou o marca como livre,
+   se é o primeiro do bloco) sem mover os demais.
+
+   Uma entrada é identificada pela sua posição em bytes no diretório, que não
+   muda enquanto ela existe. O tamanho do diretório é sempre um múltiplo do
+   tamanho do bloco. */
+
+int dir_record_read(char* block, int byteStart, DirectoryItem* item) {
+    /* Copia o registro em byteStart para item e retorna o seu tamanho no bloco */
+    DirectoryRecord* record = (DirectoryRecord*) &block[byteStart];
+    int nameLength = record->nameLength < MAX_FILE_NAME ? record->nameLength : MAX_FILE_NAME - 1;
+
+    item->inode = record->inode;
+    bcopy((unsigned char*) &block[byteStart + sizeof(DirectoryRecord)], (unsigned char*) item->name, nameLength);
+    item->name[nameLength] = '\0';
+
+    /* Um registro corrompido encerra o bloco em vez de levar a um laço infinito */
+    if(record->length < sizeof(DirectoryRecord) || byteStart + record->length > BLOCK_SIZE)
+        return BLOCK_SIZE - byteStart;
+
+    return record->length;
+}
+
+void dir_block_init(char* block) {
+    /* Um bloco vazio tem um único registro livre que cobre o bloco */
+    DirectoryRecord* record = (DirectoryRecord*) block;
+
+    bzero(block, BLOCK_SIZE);
+    record->inode = -1;
+    record->length = BLOCK_SIZE;
+}
+
+int dir_block_is_empty(char* block) {
+    DirectoryRecord* record = (DirectoryRecord*) block;
+
+    return record->inode == -1 && record->length == BLOCK_SIZE;
+}
+
+int dir_block_insert(char* block, char* name, int inodeNumber, int fileType) {
+    /* Grava a entrada no primeiro espaço livre do bloco que a comporte e retorna a sua posição no bloco ou -1 */
+    int nameLength = strlen(name);
+    int needed = DIR_RECORD_SIZE(nameLength);
+    int offset = 0;
+
+    while(offset < BLOCK_SIZE) {
+        DirectoryRecord* record = (DirectoryRecord*) &block[offset];
+        int used = record->inode == -1 ? 0 : DIR_RECORD_SIZE(record->nameLength);
+
+        if(record->length < sizeof(DirectoryRecord) || offset + record->length > BLOCK_SIZE)
+            break;
+
+        if(record->length - used >= needed) {
+            DirectoryRecord* newRecord = (DirectoryRecord*) &block[offset + used];
+
+            /* O novo registro fica com o espaço livre que sobrava no registro anterior */
+            if(used > 0) {
+                newRecord->length = record->length - used;
+                record->length = used;
+            }
+
+            newRecord->inode = inodeNumber;
+            newRecord->nameLength = nameLength;
+            newRecord->fileType = fileType;
+            bcopy((unsigned char*) name, (unsigned char*) &block[offset + used + sizeof(DirectoryRecord)], nameLength);
+
+            return offset + used;
+        }
+
+        offset += record->length;
+    }
+
+    return -1;
+}
+
+int dir_block_remove(char* block, int byteStart) {
+    /* Remove o registro em byteStart juntando o seu espaço ao registro anterior; retorna 1 se o bloco ficou vazio */
+    int previous = -1;
+    int offset = 0;
+
+    while(offset < byteStart) {
+        DirectoryRecord* record = (DirectoryRecord*) &block[offset];
+
+        if(record->length < sizeof(DirectoryRecord))
+            return 0;
+
+        previous = offset;
+        offset += record->length;
+    }
+
+    DirectoryRecord* record = (DirectoryRecord*) &block[byteStart];
+
+    if(previous == -1)
+        record->inode = -1;
+    else
+        ((DirectoryRecord*) &block[previous])->length += record->length;
+
+    return dir_block_is_empty(block);
+}
+
+void dir_block_init_empty(char* block, int inodeNumber, int parentInodeNumber) {
+    /* Primeiro bloco de um diretório novo, com as entradas . e .. */
+    dir_block_init(block);
+    dir_block_insert(block, dirEntry1, inodeNumber, DIRECTORY);
+    dir_block_insert(block, dirEntry2, parentInodeNumber, DIRECTORY);
+}
+
+int dir_next_record(Inode* inode, int* position, char* block, int* blockIndex, DirectoryItem* item) {
+    /* Avança *position até depois do próximo registro ocupado, copiado em item, e retorna a posição do registro
+       (-1 no fim do diretório). block guarda o bloco *blockIndex do diretório, lido apenas quando muda */
+    int size = inode_data_size(inode);
+
+    while(*position < size) {
+        int index = *position / BLOCK_SIZE;
+        int found = *position;
+
+        if(index != *blockIndex) {
+            int diskBlock = bmap(inode, index);
+
+            /* Um bloco não mapeado encerra a leitura, em vez de ler o bloco -1 */
+            if(diskBlock == -1)
+                return -1;
+
+            bcache_read(diskBlock, block);
+            *blockIndex = index;
+        }
+
+        *position += dir_record_read(block, found % BLOCK_SIZE, item);
+
+        if(item->inode != -1)
+            return found;
+    }
+
+    return -1;
+}
+
+int dir_scan(Inode* inode, char* name, DirectoryItem* item) {
+    /* Procura name lendo os registros bloco a bloco e retorna a posição do registro (copiado em item) ou -1 */
+    char* block = (char*) malloc(BLOCK_SIZE * sizeof(char));
+    int blockIndex = -1;
+    int position = 0;
+    int found;
+
+    while((found = dir_next_record(inode, &position, block, &blockIndex, item)) != -1) {
+        if(same_string(name, item->name))
+            break;
+    }
+
+    free(block);
+
+    return found;
+}
+
+int dir_is_empty(Inode* inode) {
+    /* Um diretório vazio só tem as entradas . e .. */
+    char* block = (char*) malloc(BLOCK_SIZE * sizeof(char));
+    int blockIndex = -1;
+    int position = 0;
+    int numEntries = 0;
+    DirectoryItem item;
+
+    while(numEntries <= 2 && dir_next_record(inode, &position, block, &blockIndex, &item) != -1)
+        numEntries++;
+
+    free(block);
+
+    return numEntries <= 2;
+}
@@ -0,0 +1,408 @@
+/* Índice hash dos diretórios
+
+   Diretórios com mais de DIR_INDEX_MIN_BLOCKS blocos de entradas ganham um
+   índice em disco, semelhante ao htree do ext3, que leva o hash de cada nome à
+   posição da sua entrada. As entradas continuam no formato de sempre; o índice
+   é uma tabela hash de endereçamento aberto (sondagem linear) guardada em
+   algumas sequências de blocos, para que o índice possa ser criado mesmo em um
+   disco fragmentado. O primeiro bloco do índice fica no inode do diretório
+   (veja dir_index_block).
+
+   Uma busca lê o bloco com o balde do hash e o bloco do registro encontrado,
+   em vez de todas as entradas do diretório. O índice recebe cada nova entrada
+   e é reconstruído, com mais baldes, quando passa da metade da ocupação. Uma
+   remoção apaga o balde da entrada removida, deslocando para trás os baldes
+   seguintes da mesma sequência de sondagem. */
+
+#define DIR_INDEX_MIN_BLOCKS 2
+
+unsigned int dir_hash(char* name) {
+    /* FNV-1a sobre os bytes do nome */
+    unsigned int hash = 2166136261u;
+
+    for(int i = 0; i < MAX_FILE_NAME && name[i] != '\0'; i++) {
+        hash ^= (unsigned char) name[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+/* Bloco do disco e posição, dentro dele, do balde bucket do índice cujo primeiro bloco é header */
+int dir_bucket_block(char* header, int bucket, int* byteStart) {
+    DirIndexHeader* indexHeader = (DirIndexHeader*) header;
+    DirIndexRun* runs = (DirIndexRun*) &header[sizeof(DirIndexHeader)];
+    int offset = bucket * sizeof(DirIndexBucket);
+    int logical = 1 + offset / BLOCK_SIZE;
+
+    *byteStart = offset % BLOCK_SIZE;
+
+    for(int i = 0; i < indexHeader->numRuns; i++) {
+        if(logical < runs[i].length)
+            return runs[i].start + logical;
+
+        logical -= runs[i].length;
+    }
+
+    return -1;
+}
+
+void dir_index_free(Inode* inode) {
+    int first = dir_index_block(inode);
+
+    if(first == -1)
+        return;
+
+    char* header = (char*) malloc(BLOCK_SIZE * sizeof(char));
+    DirIndexHeader* indexHeader = (DirIndexHeader*) header;
+    DirIndexRun* runs = (DirIndexRun*) &header[sizeof(DirIndexHeader)];
+
+    bcache_read(first, header);
+
+    if(indexHeader->magic == DIR_INDEX_MAGIC) {
+        for(int i = 0; i < indexHeader->numRuns && i < DIR_INDEX_MAX_RUNS; i++) {
+            for(int j = 0; j < runs[i].length; j++)
+                free_bit(&dataBitmap, runs[i].start + j - DATA_BLOCK_START);
+        }
+    } else if(indexHeader->magic == DIR_INDEX_MAGIC_CONTIGUOUS) {
+        for(int i = 0; i < indexHeader->numBlocks; i++)
+            free_bit(&dataBitmap, first + i - DATA_BLOCK_START);
+    }
+
+    dir_set_index_block(inode, -1);
+
+    free(header);
+}
+
+int dir_index_alloc(int inodeNumber, int numBlocks, DirIndexRun* runs) {
+    /* Reserva numBlocks blocos em até DIR_INDEX_MAX_RUNS sequências, preferindo as maiores próximas ao diretório.
+       Retorna a quantidade de sequências ou -1 (sem reservar nada) se não há espaço */
+    int numRuns = 0;
+    int allocated = 0;
+    int goal = group_data_goal(inodeNumber);
+
+    while(allocated < numBlocks && numRuns < DIR_INDEX_MAX_RUNS) {
+        int length;
+        int first = alloc_run(&dataBitmap, goal, numBlocks - allocated, &length);
+
+        if(first == -1)
+            break;
+
+        runs[numRuns].start = first + DATA_BLOCK_START;
+        runs[numRuns].length = length;
+        numRuns++;
+
+        allocated += length;
+        goal = first + length;
+    }
+
+    if(allocated < numBlocks) {
+        for(int i = 0; i < numRuns; i++) {
+            for(int j = 0; j < runs[i].length; j++)
+                free_bit(&dataBitmap, runs[i].start + j - DATA_BLOCK_START);
+        }
+
+        return -1;
+    }
+
+    return numRuns;
+}
+
+void dir_index_build(Inode* inode, int inodeNumber) {
+    /* Descarta o índice atual e só cria um novo se o diretório ainda for grande */
+    dir_index_free(inode);
+
+    int size = inode_data_size(inode);
+
+    if(size <= DIR_INDEX_MIN_BLOCKS * BLOCK_SIZE) {
+        save_inode(inode, inodeNumber);
+        return;
+    }
+
+    /* Conta as entradas do diretório */
+    char* block = (char*) malloc(BLOCK_SIZE * sizeof(char));
+    int blockIndex = -1;
+    int position = 0;
+    int numEntries = 0;
+    DirectoryItem item;
+
+    while(dir_next_record(inode, &position, block, &blockIndex, &item) != -1)
+        numEntries++;
+
+    /* Começa com ocupação de no máximo um quarto, para que o diretório dobre de tamanho antes da próxima reconstrução */
+    int numBuckets = 1;
+
+    while(numBuckets < 4 * numEntries)
+        numBuckets <<= 1;
+
+    int numBlocks = 1 + (numBuckets * sizeof(DirIndexBucket) + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    char* buffer = (char*) malloc(numBlocks * BLOCK_SIZE * sizeof(char));
+    DirIndexHeader* header = (DirIndexHeader*) buffer;
+    DirIndexRun* runs = (DirIndexRun*) &buffer[sizeof(DirIndexHeader)];
+
+    bzero(buffer, numBlocks * BLOCK_SIZE);
+
+    int numRuns = dir_index_alloc(inodeNumber, numBlocks, runs);
+
+    /* Em um disco fragmentado demais, tenta um índice com metade dos baldes, que ainda recebe novas entradas */
+    if(numRuns == -1 && numBuckets / 2 > 2 * (numEntries + 1)) {
+        numBuckets /= 2;
+        numBlocks = 1 + (numBuckets * sizeof(DirIndexBucket) + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        numRuns = dir_index_alloc(inodeNumber, numBlocks, runs);
+    }
+
+    /* Sem espaço para o índice, o diretório continua sem índice */
+    if(numRuns == -1) {
+        save_inode(inode, inodeNumber);
+        free(block);
+        free(buffer);
+        return;
+    }
+
+    /* Monta o índice inteiro em memória a partir dos registros do diretório */
+    DirIndexBucket* buckets = (DirIndexBucket*) &buffer[BLOCK_SIZE];
+
+    header->magic = DIR_INDEX_MAGIC;
+    header->numBlocks = numBlocks;
+    header->numBuckets = numBuckets;
+    header->numEntries = numEntries;
+    header->numRuns = numRuns;
+
+    for(int i = 0; i < numBuckets; i++)
+        buckets[i].position = -1;
+
+    position = 0;
+    int found;
+
+    while((found = dir_next_record(inode, &position, block, &blockIndex, &item)) != -1) {
+        unsigned int hash = dir_hash(item.name);
+        int bucket = hash & (numBuckets - 1);
+
+        while(buckets[bucket].position != -1)
+            bucket = (bucket + 1) & (numBuckets - 1);
+
+        buckets[bucket].hash = hash;
+        buckets[bucket].position = found;
+    }
+
+    /* Escreve cada sequência de blocos do índice */
+    int logical = 0;
+
+    for(int i = 0; i < numRuns; i++) {
+        for(int j = 0; j < runs[i].length; j++, logical++)
+            bcache_write(runs[i].start + j, &buffer[logical * BLOCK_SIZE]);
+    }
+
+    dir_set_index_block(inode, runs[0].start);
+    save_inode(inode, inodeNumber);
+
+    free(block);
+    free(buffer);
+}
+
+char* dir_index_header(Inode* inode) {
+    /* Lê o primeiro bloco do índice ou retorna NULL se ele não tem o formato atual */
+    char* header = (char*) malloc(BLOCK_SIZE * sizeof(char));
+
+    bcache_read(dir_index_block(inode), header);
+
+    if(((DirIndexHeader*) header)->magic != DIR_INDEX_MAGIC) {
+        free(header);
+        return NULL;
+    }
+
+    return header;
+}
+
+void dir_bucket_read(char* header, int bucket, DirIndexBucket* entry) {
+    int byteStart;
+    char* buffer = (char*) malloc(BLOCK_SIZE * sizeof(char));
+
+    bcache_read(dir_bucket_block(header, bucket, &byteStart), buffer);
+    bcopy((unsigned char*) &buffer[byteStart], (unsigned char*) entry, sizeof(DirIndexBucket));
+
+    free(buffer);
+}
+
+void dir_bucket_write(char* header, int bucket, DirIndexBucket* entry) {
+    int byteStart;
+    char* buffer = (char*) malloc(BLOCK_SIZE * sizeof(char));
+    int block = dir_bucket_block(header, bucket, &byteStart);
+
+    bcache_read(block, buffer);
+    bcopy((unsigned char*) entry, (unsigned char*) &buffer[byteStart], sizeof(DirIndexBucket));
+    bcache_write(block, buffer);
+
+    free(buffer);
+}
+
+int dir_index_insert(Inode* inode, char* name, int position) {
+    /* Acrescenta ao índice a entrada na posição position; retorna -1 se o índice precisa ser reconstruído */
+    char* header = dir_index_header(inode);
+
+    if(header == NULL)
+        return -1;
+
+    DirIndexHeader* indexHeader = (DirIndexHeader*) header;
+
+    if(2 * (indexHeader->numEntries + 1) > indexHeader->numBuckets) {
+        free(header);
+        return -1;
+    }
+
+    /* Atualiza o contador no cabeçalho */
+    indexHeader->numEntries++;
+    bcache_write(dir_index_block(inode), header);
+
+    /* Procura o primeiro balde vazio a partir do hash do nome */
+    unsigned int hash = dir_hash(name);
+    int bucket = hash & (indexHeader->numBuckets - 1);
+    DirIndexBucket entry;
+
+    for(;;) {
+        dir_bucket_read(header, bucket, &entry);
+
+        if(entry.position == -1) {
+            entry.hash = hash;
+            entry.position = position;
+            dir_bucket_write(header, bucket, &entry);
+            break;
+        }
+
+        bucket = (bucket + 1) & (indexHeader->numBuckets - 1);
+    }
+
+    free(header);
+
+    return 0;
+}
+
+void dir_index_add(Inode* inode, int inodeNumber, char* name, int position) {
+    /* Mantém o índice de um diretório que recebeu a entrada na posição position, criando-o quando o diretório passa do limite.
+       Sem índice, a criação só é tentada quando a entrada começa um bloco, para que a falta de espaço no disco não
+       leve a uma tentativa a cada entrada */
+    if(dir_index_block(inode) == -1) {
+        if(inode_data_size(inode) > DIR_INDEX_MIN_BLOCKS * BLOCK_SIZE && position % BLOCK_SIZE == 0)
+            dir_index_build(inode, inodeNumber);
+    } else if(dir_index_insert(inode, name, position) != 0) {
+        dir_index_build(inode, inodeNumber);
+    }
+}
+
+int dir_index_find(Inode* inode, char* name, DirectoryItem* item) {
+    /* Retorna a posição do registro com o nome name (copiado em item) ou -1 se não existe */
+    char* header = dir_index_header(inode);
+
+    /* Um índice de formato anterior é ignorado até ser reconstruído */
+    if(header == NULL)
+        return dir_scan(inode, name, item);
+
+    DirIndexHeader* indexHeader = (DirIndexHeader*) header;
+    char* buffer = (char*) malloc(BLOCK_SIZE * sizeof(char));
+    char* recordBlock = (char*) malloc(BLOCK_SIZE * sizeof(char));
+    int position = -1;
+
+    unsigned int hash = dir_hash(name);
+    int bucket = hash & (indexHeader->numBuckets - 1);
+    int current = -1;
+    int byteStart;
+
+    /* Segue a sondagem até um balde vazio, lendo apenas as entradas com o mesmo hash */
+    for(int i = 0; i < indexHeader->numBuckets; i++) {
+        int block = dir_bucket_block(header, bucket, &byteStart);
+
+        if(block != current) {
+            bcache_read(block, buffer);
+            current = block;
+        }
+
+        DirIndexBucket entry;
+        bcopy((unsigned char*) &buffer[byteStart], (unsigned char*) &entry, sizeof(DirIndexBucket));
+
+        if(entry.position == -1)
+            break;
+
+        if(entry.hash == hash) {
+            bcache_read(bmap(inode, entry.position / BLOCK_SIZE), recordBlock);
+            dir_record_read(recordBlock, entry.position % BLOCK_SIZE, item);
+
+            if(item->inode != -1 && same_string(name, item->name)) {
+                position = entry.position;
+                break;
+            }
+        }
+
+        bucket = (bucket + 1) & (indexHeader->numBuckets - 1);
+    }
+
+    free(header);
+    free(buffer);
+    free(recordBlock);
+
+    return position;
+}
+
+int dir_index_find_bucket(char* header, char* name, int position) {
+    /* Retorna o balde que aponta para a entrada na posição position, cujo nome é name, ou -1 se não existe */
+    int numBuckets = ((DirIndexHeader*) header)->numBuckets;
+    unsigned int hash = dir_hash(name);
+    int bucket = hash & (numBuckets - 1);
+
+    for(int i = 0; i < numBuckets; i++) {
+        DirIndexBucket entry;
+        dir_bucket_read(header, bucket, &entry);
+
+        if(entry.position == -1)
+            break;
+
+        if(entry.position == position)
+            return bucket;
+
+        bucket = (bucket + 1) & (numBuckets - 1);
+    }
+
+    return -1;
+}
+
+void dir_index_remove(Inode* inode, char* name, int position) {
+    /* Retira do índice a entrada na posição position */
+    char* header = dir_index_header(inode);
+
+    if(header == NULL)
+        return;
+
+    DirIndexHeader* indexHeader = (DirIndexHeader*) header;
+    DirIndexBucket entry;
+    int hole = dir_index_find_bucket(header, name, position);
+
+    if(hole != -1) {
+        int mask = indexHeader->numBuckets - 1;
+        int next = hole;
+
+        /* Desloca para trás os baldes da sequência de sondagem que não ficariam mais alcançáveis com o buraco */
+        for(;;) {
+            next = (next + 1) & mask;
+            dir_bucket_read(header, next, &entry);
+
+            if(entry.position == -1)
+                break;
+
+            int home = entry.hash & mask;
+
+            if(((next - home) & mask) >= ((next - hole) & mask)) {
+                dir_bucket_write(header, hole, &entry);
+                hole = next;
+            }
+        }
+
+        entry.position = -1;
+        entry.hash = 0;
+        dir_bucket_write(header, hole, &entry);
+
+        /* Atualiza o contador no cabeçalho */
+        indexHeader->numEntries--;
+        bcache_write(dir_index_block(inode), header);
+    }
+
+    free(header);
+}
@@ -1,134 +1,153 @@
+/* Descritores livres, em uma pilha, e descritores abertos, em uma tabela hash pelo inode do arquivo
+   com FD_TABLE_SIZE listas encadeadas por fdHashNext */
+int* fdFreeStack = NULL;
+int fdFreeCount = 0;
+int* fdHash = NULL;
+int* fdHashNext = NULL;
+
 File** init_fd_table() {
     /* Cria um vetor de descritores de arquivos */
-    File** fd_table = (File**) malloc(FD_TABLE_SIZE * sizeof(File));
+    File** fd_table = (File**) malloc(FD_TABLE_SIZE * sizeof(File*));
+
+    free(fdFreeStack);
+    free(fdHash);
+    free(fdHashNext);
 
-    /* Seta todas as posições do vetor de descritores de arquivos para NULL */
+    fdFreeStack = (int*) malloc(FD_TABLE_SIZE * sizeof(int));
+    fdHash = (int*) malloc(FD_TABLE_SIZE * sizeof(int));
+    fdHashNext = (int*) malloc(FD_TABLE_SIZE * sizeof(int));
+
+    /* Seta todas as posições do vetor de descritores de arquivos para NULL e empilha os descritores livres,
+       com o descritor 0 no topo */
     for(int i = 0; i < FD_TABLE_SIZE; i++) {
         fd_table[i] = NULL;
+        fdFreeStack[i] = FD_TABLE_SIZE - 1 - i;
+        fdHash[i] = -1;
     }
 
+    fdFreeCount = FD_TABLE_SIZE;
+
     /* Retorna referência para o vetor de descritores de arquivos */
     return fd_table;
 }
 
-void set_bit(char* bytes, int index, int n) {
-    /* Seta n-esimo bit de um byte na posição index de um vetor de bytes para 1 */
-    bytes[index] = ((1 << n) | bytes[index]);
-}
+int fd_alloc(File* file) {
+    /* Guarda file no descritor do topo da pilha de livres e retorna o seu número ou -1 se a tabela está cheia */
+    if(fdFreeCount == 0)
+        return -1;
 
-void unset_bit(char* bytes, int index, int n) {
-    /* Seta n-esimo bit de um byte na posição index de um vetor de bytes para 0 */
-    bytes[index] = bytes[index] & (~(1 << (7 - n)));
-}
+    int fd = fdFreeStack[--fdFreeCount];
+    int bucket = file->inode % FD_TABLE_SIZE;
 
-int get_bit(char* bytes, int index, int n) {
-    /* Retorna n-esimo bit de um byte na posição index de um vetor de bytes */
-    return (bytes[index] >> n) & 1;
-}
+    fdTable[fd] = file;
+    fdHashNext[fd] = fdHash[bucket];
+    fdHash[bucket] = fd;
+    numFileDescriptors++;
 
-void load_bitmap(char* bitmap, int block) {
-    int size;
+    return fd;
+}
 
-    /* Define tamanho do vetor de bits */
-    if(block == D_MAP_BLOCK)
-        size = D_MAP_SIZE;
-    else
-        size = I_MAP_SIZE;
+void fd_release(int fd) {
+    /* Retira o descritor da lista do seu inode, libera o File e devolve o número à pilha de livres */
+    int* link = &fdHash[fdTable[fd]->inode % FD_TABLE_SIZE];
 
-    /* Aloca memória para variável buffer */
-    char* buffer = (char*) malloc(BLOCK_SIZE * sizeof(char));
+    while(*link != -1 && *link != fd)
+        link = &fdHashNext[*link];
 
-    /* Busca o vetor de bits e copia para variável bitmap */
-    block_read(block, buffer);
-    bcopy((unsigned char*) buffer, (unsigned char*) bitmap, size);
+    if(*link == fd)
+        *link = fdHashNext[fd];
 
-    /* Libera memória alocada para a variável buffer */
-    free(buffer);
+    release_inode(fdTable[fd]->pinnedInode);
+    free(fdTable[fd]->blockMap);
+    free(fdTable[fd]);
+    fdTable[fd] = NULL;
+    fdFreeStack[fdFreeCount++] = fd;
+    numFileDescriptors--;
 }
 
-int find_free_bit_number(char* bitmap, int size) {
-    /* Variável utilizada para guardar número de um bit livre */
-    int bitNumber = -1;
-
-    /* Percorre cada byte do vetor de bits */
-    for(int i = 0; i < size; i++) {
-        /* Percorre cada bit do byte do vetor de bits */
-        for(int j = 7; j > -1; j--) {
-            /* Descobre o valor de um bit dentro de um byte */
-            int bit = get_bit(bitmap, i, j);
-
-            /* Verifica se o bit é 0, ou seja, se o bit correspondente está livre */
-            if(bit == 0) {
-                /* Calcula o número do bit livre */
-                bitNumber = 7 - j + (i * 8);
-
-                /* Seta bit para 1, marcando o bit correspondente como ocupado */
-                set_bit(bitmap, i, j);
-                break;
-            }
+void fd_invalidate_block_maps(int inodeNumber) {
+    /* Descarta os mapas de blocos dos descritores abertos para o inode, cujos blocos foram liberados */
+    for(int fd = fdHash[inodeNumber % FD_TABLE_SIZE]; fd != -1; fd = fdHashNext[fd]) {
+        if(fdTable[fd]->inode == inodeNumber) {
+            free(fdTable[fd]->blockMap);
+            fdTable[fd]->blockMap = NULL;
+            fdTable[fd]->mapSize = 0;
         }
-
-        /* Encerra loop se já encontrou um bit livre */
-        if(bitNumber != -1)
-            break;
     }
-
-    /* Retorna número do bit livre ou -1 caso não tenha bits livres */
-    return bitNumber;
 }
 
-void save_bitmap(char* bitmap, int block) {
-    int size;
+void file_bmap_range(File* file, int blockStart, int blockEnd, int blocks[]) {
+    /* Traduz os blocos pelo mapa do descritor, consultando o inode apenas quando algum deles ainda não foi traduzido */
+    int fileBlocks = (inode_data_size(file->pinnedInode) + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    int first = blockStart;
 
-    /* Define tamanho do vetor de bits */
-    if(block == D_MAP_BLOCK)
-        size = D_MAP_SIZE;
-    else
-        size = I_MAP_SIZE;
+    while(first < blockEnd + 1 && first < file->mapSize && file->blockMap[first] != 0)
+        first++;
 
-    /* Aloca memória para variável buffer */
-    char* buffer = (char*) malloc(BLOCK_SIZE * sizeof(char));
-    bzero(buffer, BLOCK_SIZE);
+    if(first < blockEnd + 1) {
+        /* Traduz o intervalo e mais FD_MAP_READ_AHEAD blocos (sem passar do fim do arquivo), para que uma leitura sequencial consulte o inode poucas vezes */
+        int last = blockEnd + FD_MAP_READ_AHEAD < fileBlocks - 1 ? blockEnd + FD_MAP_READ_AHEAD : fileBlocks - 1;
 
-    /* Copia vetor de bits para a variável buffer */
-    bcopy((unsigned char*) bitmap, (unsigned char*) buffer, size);
-    block_write(block, buffer);
+        if(last < blockEnd)
+            last = blockEnd;
 
-    /* Libera memória alocada para a variável buffer */
-    free(buffer);
-}
+        /* O mapa cresce apenas até o último bloco traduzido */
+        if(last >= file->mapSize) {
+            file->blockMap = (int*) realloc(file->blockMap, (last + 1) * sizeof(int));
+            bzero((char*) &file->blockMap[file->mapSize], (last + 1 - file->mapSize) * sizeof(int));
+            file->mapSize = last + 1;
+        }
 
-Inode* find_inode(int inodeNumber) {
-    /* Verifica se o número de inode é um número válido */
-    if(inodeNumber < 0 || inodeNumber > NUMBER_OF_INODES - 1)
-        return NULL;
+        int* mapped = (int*) malloc((last - first + 1) * sizeof(int));
 
-    /* Aloca memória para a variável buffer */
-    char* buffer = (char*) malloc(2 * BLOCK_SIZE * sizeof(char));
+        bmap_range(file->pinnedInode, first, last, mapped);
 
-    /* Zera todos os bytes da variável buffer e copia o inode correspondente para o buffer */
-    bzero(buffer, 2 * BLOCK_SIZE);
+        /* Blocos não alocados (-1) não entram no mapa, pois ainda podem ser alocados por uma escrita */
+        for(int i = first; i < last + 1; i++)
+            file->blockMap[i] = mapped[i - first] != -1 ? mapped[i - first] : 0;
 
-    /* Calcula em quais blocos estão o inode a ser encontrado */
-    int start = inodeNumber * sizeof(Inode);
-    int end = start + sizeof(Inode) - 1;
-    int blockStart = start / BLOCK_SIZE;
-    int blockEnd = end / BLOCK_SIZE;
-
-    /* Copia os blocos para a variável buffer */
-    for(int i = blockStart; i < blockEnd + 1; i++) {
-        block_read(i + INODE_START, &buffer[(i - blockStart) * BLOCK_SIZE]);
+        free(mapped);
     }
 
-    /* Copia os bytes do buffer para uma estrutura inode */
-    Inode* inode = (Inode*) malloc(sizeof(Inode));
-    bcopy((unsigned char*) &buffer[start % BLOCK_SIZE], (unsigned char*) inode, sizeof(Inode));
+    for(int i = blockStart; i < blockEnd + 1; i++)
+        blocks[i - blockStart] = file->blockMap[i] != 0 ? file->blockMap[i] : -1;
+}
 
-    /* Libera memória alocada */
-    free(buffer);
+int fd_find_inode(int inodeNumber) {
+    /* Retorna um descritor aberto para o inode ou -1 */
+    int fd = fdHash[inodeNumber % FD_TABLE_SIZE];
 
-    /* Retorna a referência para o inode encontrado */
-    return inode;
+    while(fd != -1 && fdTable[fd]->inode != inodeNumber)
+        fd = fdHashNext[fd];
+
+    return fd;
+}
+
+/* Dica, por diretório, do bloco com espaço livre deixado por uma remoção */
+#define DIR_HINT_SIZE 64
+
+typedef struct {
+    int dir;
+    int block;
+} DirSpaceHint;
+
+DirSpaceHint dirSpaceHints[DIR_HINT_SIZE];
+
+/* Inode de uma entrada e a sua posição no lote devolvido por fs_readdir_plus */
+typedef struct {
+    int inode;
+    int index;
+} InodeRef;
+
+void invalidate_dir_streams() {
+    /* Fecha os diretórios abertos (o disco será formatado) */
+    for(int i = 0; i < DIR_TABLE_SIZE; i++) {
+        if(dirTable[i] != NULL) {
+            free(dirTable[i]->block);
+            free(dirTable[i]);
+            dirTable[i] = NULL;
+        }
+    }
 }
 
 Inode* create_new_inode() {
@@ -138,83 +157,192 @@ Inode* create_new_inode() {
     
     /* Define o valor inicial da contagem de links para 1 */
     inode->linkCount = 1;
-    /* Desabilita uso dos blocos indiretos inicialmente */
-    inode->singleIndirect = -1;
+    inode->size = 0;
+    inode->flags = 0;
+    /* Inicializa o mapeamento de blocos vazio (sem blocos de dados) */
+    inode_init_map(inode);
 
     /* Retorna um ponteiro para o inode criado */
     return inode;
 }
 
-void save_inode(Inode* inode, int inodeNumber) {
-    /* Aloca memória para a variável buffer */
-    char* buffer_ = (char*) malloc(2 * BLOCK_SIZE * sizeof(char));
+int collect_n_blocks(Inode* inode, File* file, char* buffer, int blockStart, int blockEnd, block_io_t* iov) {
+    int* blocks = (int*) malloc((blockEnd - blockStart + 1) * sizeof(int));
+    int count = 0;
+
+    /* Traduz todo o intervalo de uma vez para blocos do disco, pelo mapa do descritor quando há um */
+    if(file != NULL)
+        file_bmap_range(file, blockStart, blockEnd, blocks);
+    else
+        bmap_range(inode, blockStart, blockEnd, blocks);
+
+    /* Monta a lista (bloco, memória) até o último bloco alocado do intervalo */
+    for(int i = blockStart; i < blockEnd + 1 && blocks[i - blockStart] != -1; i++) {
+        iov[count].block = blocks[i - blockStart];
+        iov[count].mem = &buffer[(i - blockStart) * BLOCK_SIZE];
+        count++;
+    }
+
+    free(blocks);
+
+    return count;
+}
+
+void read_n_blocks(Inode* inode, char* buffer, int blockStart, int blockEnd) {
+    block_io_t* iov = (block_io_t*) malloc((blockEnd - blockStart + 1) * sizeof(block_io_t));
+
+    /* Lê todos os blocos em uma única requisição vetorizada */
+    bcache_readv(iov, collect_n_blocks(inode, NULL, buffer, blockStart, blockEnd, iov));
+
+    free(iov);
+}
+
+void write_n_blocks(Inode* inode, char* buffer, int blockStart, int blockEnd) {
+    block_io_t* iov = (block_io_t*) malloc((blockEnd - blockStart + 1) * sizeof(block_io_t));
+
+    /* Escreve todos os blocos em uma única requisição vetorizada */
+    bcache_writev(iov, collect_n_blocks(inode, NULL, buffer, blockStart, blockEnd, iov));
+
+    free(iov);
+}
+
+void read_file_blocks(File* file, char* buffer, int blockStart, int blockEnd) {
+    block_io_t* iov = (block_io_t*) malloc((blockEnd - blockStart + 1) * sizeof(block_io_t));
+
+    /* Como read_n_blocks, mas com os blocos traduzidos pelo mapa do descritor */
+    bcache_readv(iov, collect_n_blocks(file->pinnedInode, file, buffer, blockStart, blockEnd, iov));
+
+    free(iov);
+}
+
+void write_file_blocks(File* file, char* buffer, int blockStart, int blockEnd) {
+    block_io_t* iov = (block_io_t*) malloc((blockEnd - blockStart + 1) * sizeof(block_io_t));
+
+    /* Como write_n_blocks, mas com os blocos traduzidos pelo mapa do descritor */
+    bcache_writev(iov, collect_n_blocks(file->pinnedInode, file, buffer, blockStart, blockEnd, iov));
+
+    free(iov);
+}
+
+void commit_file_blocks(File* file, char* buffer, int blockStart, int blockEnd) {
+    block_io_t* iov = (block_io_t*) malloc((blockEnd - blockStart + 1) * sizeof(block_io_t));
+
+    /* Como write_file_blocks, mas junto com os mapas de bits, os inodes e os blocos de mapeamento modificados */
+    flush_bitmaps();
+    flush_inodes();
+    bcache_commit(iov, collect_n_blocks(file->pinnedInode, file, buffer, blockStart, blockEnd, iov));
+
+    free(iov);
+}
 
-    /* Zera todos os bytes da variável buffer e copia o inode correspondente para o buffer */
-    bzero(buffer_, 2 * BLOCK_SIZE);
+int lookup_directory_item(int dirInodeNumber, char* itemName) {
+    /* Retorna o inode do item itemName do diretório, -1 se ele não existe ou -2 se dirInodeNumber não é um diretório */
+    int inodeNumber = -1;
 
-    /* Calcula em quais blocos estão o inode a ser salvo */
-    int start = inodeNumber * sizeof(Inode);
-    int end = start + sizeof(Inode) - 1;
-    int blockStart = start / BLOCK_SIZE;
-    int blockEnd = end / BLOCK_SIZE;
+    /* Buscas repetidas são resolvidas pela cache de dentries, inclusive as de nomes inexistentes */
+    if(dcache_lookup(dirInodeNumber, itemName, &inodeNumber))
+        return inodeNumber;
 
-    /* Copia os blocos para a variável buffer */
-    for(int i = blockStart; i < blockEnd + 1; i++) {
-        block_read(i + INODE_START, &buffer_[(i - blockStart) * BLOCK_SIZE]);
+    /* Recupera o inode do diretório */
+    Inode* inode = find_inode(dirInodeNumber);
+
+    if(inode->type != DIRECTORY) {
+        release_inode(inode);
+        return -2;
     }
 
-    /* Copia os bytes correspondentes ao inode na variável buffer na posição correspondente a posição do inode */
-    bcopy((unsigned char*) inode, (unsigned char*) &buffer_[start % BLOCK_SIZE], sizeof(Inode));
+    if(dir_index_block(inode) != -1) {
+        /* Diretórios grandes são consultados pelo índice hash, sem ler todas as entradas */
+        DirectoryItem item;
+
+        if(dir_index_find(inode, itemName, &item) != -1)
+            inodeNumber = item.inode;
+    } else {
+        /* Os demais são percorridos registro a registro */
+        DirectoryItem item;
 
-    /* Copia os blocos da variável buffer para o disco */
-    for(int i = blockStart; i < blockEnd + 1; i++) {
-        block_write(i + INODE_START, &buffer_[(i - blockStart) * BLOCK_SIZE]);
+        if(dir_scan(inode, itemName, &item) != -1)
+            inodeNumber = item.inode;
     }
 
-    /* Libera memória alocada dinâmicamente */
-    free(buffer_);
+    /* Guarda o resultado, positivo ou negativo, na cache */
+    dcache_insert(dirInodeNumber, itemName, inodeNumber);
+
+    release_inode(inode);
+
+    return inodeNumber;
 }
 
-DirectoryItem* get_directory_items(int inodeNumber) {
-    /* Recupera o inode do diretório atual */
-    Inode* inode = find_inode(inodeNumber);
+int resolve_parent(char* path, char* name) {
+    /* Percorre os componentes de path, menos o último, a partir da raiz (caminhos absolutos) ou do diretório atual.
+       Retorna o inode do diretório que deve conter o último componente, copiado em name, ou -1 se o caminho é inválido.
+       Um caminho formado só por barras, como "/", tem "." como último componente. */
+    if(path[0] == '\0' || strlen(path) >= MAX_PATH_NAME)
+        return -1;
 
-    /* Verifica se o inode corresponde a um inode de diretório */
-    if(inode->type != DIRECTORY)
-        return NULL;
+    int dirInodeNumber = path[0] == '/' ? ROOT_INODE : superblock->workingDirectory;
+    int i = 0;
 
-    /* Calcula quantos blocos de dados o diretório utiliza */
-    int numBlocks = (int) ceil((double) inode->size / BLOCK_SIZE);
+    bcopy((unsigned char*) dirEntry1, (unsigned char*) name, MAX_FILE_NAME);
 
-    /* Cria uma variável buffer para armazenar os blocos de dados */
-    char* buffer = (char*) malloc(numBlocks * BLOCK_SIZE * sizeof(char));
+    while(1) {
+        /* Pula as barras antes do componente e mede o seu tamanho */
+        while(path[i] == '/')
+            i++;
 
-    /* Lê cada bloco de dados correspondente ao diretório a ser consultado */
-    for(int i = 0; i < numBlocks; i++) {
-        block_read(inode->direct[i], &buffer[i * BLOCK_SIZE]);
-    }
+        int length = 0;
 
-    /* Aloca um vetor de diretórios dinamicamente */
-    DirectoryItem* directoryItems = (DirectoryItem*) malloc(inode->size);
-    /* Copia os bytes do buffer para o vetor de diretórios */
-    bcopy((unsigned char*) buffer, (unsigned char*) directoryItems, inode->size);
+        while(path[i + length] != '\0' && path[i + length] != '/')
+            length++;
 
-    /* Libera a memória alocada dinâmicamente */
-    free(buffer);
-    free(inode);
+        if(length == 0)
+            break;
+
+        if(length >= MAX_FILE_NAME)
+            return -1;
+
+        bcopy((unsigned char*) &path[i], (unsigned char*) name, length);
+        name[length] = '\0';
+        i += length;
+
+        /* O último componente (seguido apenas de barras) não é resolvido */
+        int next = i;
+
+        while(path[next] == '/')
+            next++;
 
-    /* Retorna um ponteiro para a lista de diretórios */
-    return directoryItems;
+        if(path[next] == '\0')
+            break;
+
+        /* Cada componente intermediário é resolvido pela cache de dentries, sem ler o diretório se já foi visto */
+        dirInodeNumber = lookup_directory_item(dirInodeNumber, name);
+
+        if(dirInodeNumber < 0)
+            return -1;
+    }
+
+    /* O último diretório do caminho precisa realmente ser um diretório */
+    Inode* inode = find_inode(dirInodeNumber);
+    int type = inode->type;
+    release_inode(inode);
+
+    return type == DIRECTORY ? dirInodeNumber : -1;
 }
 
 DirectoryItem* get_directory_item(char* itemName, ...) {
     /* Variável utilizada para guardar o número do inode do diretório onde o arquivo que será buscado pertence */
     int dirInodeNumber;
+    char name[MAX_FILE_NAME];
 
     /* Verifica se não está sendo passado um parâmetro adicional para a função */
     if(unlink_addarg_count == 0) {
-        /* Se não, seta o número do inode para o número do inode do diretório atual */
-        dirInodeNumber = superblock->workingDirectory;
+        /* Se não, itemName é um caminho, resolvido a partir da raiz ou do diretório atual */
+        dirInodeNumber = resolve_parent(itemName, name);
+
+        if(dirInodeNumber == -1)
+            return NULL;
+
+        itemName = name;
     } else {
         /* Se sim, seta o número do inode para o número do inode recebido no parâmetro da função */
         va_list args;
@@ -226,322 +354,467 @@ DirectoryItem* get_directory_item(char* itemName, ...) {
         va_end(args);
     }
 
+    /* Procura o item no diretório */
+    int inodeNumber = lookup_directory_item(dirInodeNumber, itemName);
+
+    if(inodeNumber < 0)
+        return NULL;
+
+    /* Aloca memória para guardar o item encontrado */
+    DirectoryItem* directoryItem = (DirectoryItem*) malloc(sizeof(DirectoryItem));
+
+    int length = strlen(itemName) < MAX_FILE_NAME ? strlen(itemName) : MAX_FILE_NAME - 1;
+
+    bzero(directoryItem->name, MAX_FILE_NAME);
+    bcopy((unsigned char*) itemName, (unsigned char*) directoryItem->name, length);
+    directoryItem->inode = inodeNumber;
+
+    /* Retorna ponteiro para o item encontrado */
+    return directoryItem;
+}
+
+int item_exists(int dirInodeNumber, char* itemName) {
+    /* Retorna se há um item igual a itemName no diretório */
+    return lookup_directory_item(dirInodeNumber, itemName) != -1;
+}
+
+int dir_space_hint(int dirInodeNumber) {
+    /* Retorna o bloco do diretório onde a última remoção deixou espaço livre ou -1 */
+    DirSpaceHint* hint = &dirSpaceHints[dirInodeNumber % DIR_HINT_SIZE];
+
+    return hint->dir == dirInodeNumber ? hint->block : -1;
+}
+
+void dir_set_space_hint(int dirInodeNumber, int block) {
+    dirSpaceHints[dirInodeNumber % DIR_HINT_SIZE].dir = dirInodeNumber;
+    dirSpaceHints[dirInodeNumber % DIR_HINT_SIZE].block = block;
+}
+
+int append_directory_item(int dirInodeNumber, DirectoryItem* item, int fileType) {
     /* Recupera o inode do diretório */
     Inode* inode = find_inode(dirInodeNumber);
-    /* Recupera a lista de diretórios dentro do diretório */
-    DirectoryItem* directoryItems = get_directory_items(dirInodeNumber);
+    int numBlocks = inode_data_size(inode) / BLOCK_SIZE;
+    char* block = (char*) malloc(BLOCK_SIZE * sizeof(char));
+    int position = -1;
 
-    /* Declara ponteiro para um item de diretório */
-    DirectoryItem* directoryItem = NULL;
+    /* Tenta o bloco indicado pela dica de espaço livre e depois o último bloco do diretório */
+    int hint = dir_space_hint(dirInodeNumber);
+    int candidates[2] = { hint, numBlocks - 1 };
 
-    /* Verifica se foi retornado uma lista de items de diretórios */
-    if(directoryItems == NULL)
-        return NULL;
+    for(int i = 0; i < 2 && position == -1; i++) {
+        int index = candidates[i];
 
-    /* Percorre a lista de itens do diretórios */
-    for(int i = 0; i < (inode->size / sizeof(DirectoryItem)); i++) {
-        /* Verifica se há um diretório igual a itemName */
-        if(same_string(itemName, directoryItems[i].name)) {
-            /* Aloca memória para guardar o item encontrado */
-            directoryItem = (DirectoryItem*) malloc(sizeof(DirectoryItem));
+        if(index < 0 || index >= numBlocks || (i == 1 && index == hint))
+            continue;
 
-            /* Copia os bytes do item encontrado no vetor de diretórios para uma variável */
-            bcopy((unsigned char*) &directoryItems[i], (unsigned char*) directoryItem, sizeof(DirectoryItem));
+        bcache_read(bmap(inode, index), block);
+        int byteStart = dir_block_insert(block, item->name, item->inode, fileType);
 
-            /* Encerra o loop */
-            break;
+        if(byteStart != -1) {
+            bcache_write(bmap(inode, index), block);
+            position = index * BLOCK_SIZE + byteStart;
+        } else if(i == 0) {
+            /* O bloco da dica encheu */
+            dir_set_space_hint(dirInodeNumber, -1);
         }
     }
 
-    /* Libera memória alocada dinâmicamente */
-    free(inode);
-    free(directoryItems);
+    /* Sem espaço nos blocos existentes, acrescenta um bloco ao diretório */
+    if(position == -1) {
+        if(bmap_alloc(inode, dirInodeNumber, numBlocks, numBlocks) < 1) {
+            free(block);
+            release_inode(inode);
+            return -1;
+        }
 
-    /* Retorna ponteiro para o item encontrado */
-    return directoryItem;
+        dir_block_init(block);
+        position = numBlocks * BLOCK_SIZE + dir_block_insert(block, item->name, item->inode, fileType);
+        bcache_write(bmap(inode, numBlocks), block);
+
+        inode_set_data_size(inode, (numBlocks + 1) * BLOCK_SIZE);
+        save_inode(inode, dirInodeNumber);
+    }
+
+    /* Atualiza o índice do diretório */
+    dir_index_add(inode, dirInodeNumber, item->name, position);
+
+    /* O novo nome passa a ser resolvido pela cache de dentries (substituindo uma entrada negativa) */
+    dcache_insert(dirInodeNumber, item->name, item->inode);
+
+    /* Libera memória alocada dinamicamente */
+    free(block);
+    release_inode(inode);
+
+    return 0;
+}
+
+int find_directory_record(Inode* inode, char* itemName, DirectoryItem* item) {
+    /* Retorna a posição do registro itemName no diretório (copiado em item) ou -1 se ele não existe */
+    if(dir_index_block(inode) != -1)
+        return dir_index_find(inode, itemName, item);
+
+    return dir_scan(inode, itemName, item);
 }
 
-int item_exists(char* itemName) {
-    /* Variável de controle */
-    int exists = 0;
+void remove_directory_item(int dirInodeNumber, Inode* inode, int position, char* itemName) {
+    /* Remove o registro na posição position juntando-o ao registro anterior, o que escreve apenas o seu bloco */
+    char* block = (char*) malloc(BLOCK_SIZE * sizeof(char));
+    int index = position / BLOCK_SIZE;
+    int numBlocks = inode_data_size(inode) / BLOCK_SIZE;
 
-    /* Recupera o inode do diretório atual */
-    Inode* inode = find_inode(superblock->workingDirectory);
-    /* Recupera a lista de diretórios dentro do diretório atual */
-    DirectoryItem* directoryItems = get_directory_items(superblock->workingDirectory);
+    bcache_read(bmap(inode, index), block);
+    int empty = dir_block_remove(block, position % BLOCK_SIZE);
+    bcache_write(bmap(inode, index), block);
 
-    /* Verifica se foi retornado uma lista de diretórios */
-    if(directoryItems == NULL)
-        return 1;
+    /* Corrige o índice em vez de reconstruí-lo */
+    if(dir_index_block(inode) != -1)
+        dir_index_remove(inode, itemName, position);
 
-    /* Percorre a lista de diretórios */
-    for(int i = 0; i < (inode->size / sizeof(DirectoryItem)) && exists == 0; i++) {
-        /* Verifica se há um diretório igual a itemName */
-        if(same_string(itemName, directoryItems[i].name)) {
-            /* Seta variável de controle para verdadeiro */
-            exists = 1;
+    /* A próxima entrada do diretório reaproveita o espaço liberado */
+    dir_set_space_hint(dirInodeNumber, index);
+
+    /* Libera os blocos vazios no fim do diretório; os do meio continuam para serem reaproveitados */
+    if(empty && index == numBlocks - 1) {
+        while(numBlocks > 1) {
+            bcache_read(bmap(inode, numBlocks - 1), block);
+
+            if(!dir_block_is_empty(block))
+                break;
+
+            numBlocks--;
         }
+
+        bmap_truncate(inode, numBlocks);
+        inode_set_data_size(inode, numBlocks * BLOCK_SIZE);
+
+        /* O índice só é descartado quando o diretório volta a ser pequeno */
+        if(numBlocks * BLOCK_SIZE <= DIR_INDEX_MIN_BLOCKS * BLOCK_SIZE)
+            dir_index_free(inode);
     }
 
-    /* Libera memória alocada dinâmicamente */
-    free(inode);
-    free(directoryItems);
+    save_inode(inode, dirInodeNumber);
 
-    /* Retorna se há ou não um diretório igual a itemName no diretório atual */
-    return exists;
+    /* O nome deixa de existir no diretório */
+    dcache_insert(dirInodeNumber, itemName, -1);
+
+    free(block);
 }
 
-DirectoryItem* create_new_file(char* fileName) {
-    DirectoryItem* newDirectoryItem = NULL;
+int convert_pointer_layout() {
+    /* Reescreve os inodes de POINTER_LAYOUT_DIRECT10 em POINTER_LAYOUT_INDIRECT3; retorna -1, sem alterar o disco,
+       se não há blocos livres para os novos blocos indiretos */
+    int* blocks = (int*) malloc((LEGACY_NUM_DIRECT + ADDRESSES_PER_BLOCK) * sizeof(int));
+    int needed = 0;
+    int single;
 
-    /* Verifica se já existe um diretório/arquivo com o mesmo nome */
-    if(item_exists(fileName)) {
-        return NULL;
+    for(int i = 0; i < NUMBER_OF_INODES; i++) {
+        if(!bitmap_test(&inodeBitmap, i))
+            continue;
+
+        Inode* inode = find_inode(i);
+        int numBlocks = pointers_legacy_blocks(inode, blocks, &single);
+
+        needed += pointers_indirect_count(numBlocks) - (single != -1);
+        release_inode(inode);
     }
 
-    /* Declara vetor de bits para guardar o vetor de bits dos inodes */
-    char imap[I_MAP_SIZE];
-    load_bitmap(imap, I_MAP_BLOCK);
+    if(needed > dataBitmap.freeCount) {
+        free(blocks);
+        return -1;
+    }
 
-    /* Encontra inode livre */
-    int inodeNumber = find_free_bit_number(imap, I_MAP_SIZE);
+    for(int i = 0; i < NUMBER_OF_INODES; i++) {
+        if(!bitmap_test(&inodeBitmap, i))
+            continue;
 
-    /* Checa se houve sucesso em encontrar um inode livre */
-    if(inodeNumber == -1)
-        return NULL;
+        Inode* inode = find_inode(i);
+        int numBlocks = pointers_legacy_blocks(inode, blocks, &single);
 
-    /* Salva mapa de bits atualizado no disco */
-    save_bitmap(imap, I_MAP_BLOCK);
+        /* O tamanho antigo inclui o bloco indireto simples, que passa a não contar */
+        int size = single != -1 ? inode->size - BLOCK_SIZE : inode->size;
 
-    /* Aloca inode para o novo arquivo criado */
-    Inode* newInode = create_new_inode();
-    newInode->type = FILE_TYPE;
-    newInode->size = 0;
+        if(single != -1) {
+            indirect_forget(single);
+            free_bit(&dataBitmap, single - DATA_BLOCK_START);
+        }
 
-    for(int i = 0; i < (sizeof(newInode->direct) / 4); i++) {
-        newInode->direct[i] = -1;
-    }
+        /* O campo type tinha 4 bytes; a metade que virou flags é sempre 0 */
+        inode->flags = 0;
+        inode_init_map(inode);
 
-    newInode->singleIndirect = -1;
+        for(int j = 0; j < numBlocks; j++)
+            pointers_set(inode, j, blocks[j]);
 
-    /* Salva o inode correspondente ao arquivo no disco */
-    save_inode(newInode, inodeNumber);
+        inode_set_data_size(inode, size);
+        save_inode(inode, i);
+        release_inode(inode);
+    }
 
-    /* Recupera inode do diretório de trabalho atual */
-    Inode* inode = find_inode(superblock->workingDirectory);
+    superblock->pointerLayout = POINTER_LAYOUT_INDIRECT3;
 
-    /* Calcula o bloco de inicio e termino correspondente ao diretório atual */
-    int blockStart = inode->size / BLOCK_SIZE;
-    int blockEnd = (inode->size + sizeof(DirectoryItem) - 1) / BLOCK_SIZE;
-    int byteStart = inode->size % BLOCK_SIZE;
+    /* Grava o superbloco com a nova disposição */
+    char* block = (char*) malloc(BLOCK_SIZE * sizeof(char));
 
-    char* buffer = (char*) malloc((blockEnd - blockStart + 1) * BLOCK_SIZE * sizeof(char));
+    bzero(block, BLOCK_SIZE);
+    bcopy((unsigned char*) superblock, (unsigned char*) block, sizeof(Superblock));
+    bcache_write(SUPERBLOCK_BLOCK_NUMBER, block);
 
-    /* Lê os blocos onde o diretório atual está salvo */
-    for(int i = blockStart; i < blockEnd + 1; i++) {
-        block_read(inode->direct[i], &buffer[(i - blockStart) * BLOCK_SIZE]);
-    }
+    free(block);
+    free(blocks);
 
-    newDirectoryItem = (DirectoryItem*) malloc(sizeof(DirectoryItem));
-    bcopy((unsigned char*) fileName, (unsigned char*) newDirectoryItem->name, strlen(fileName) + 1);
-    newDirectoryItem->inode = inodeNumber;
+    return 0;
+}
 
-    /* Guarda o novo arquivo criado dentro do bloco de dados do diretório atual */
-    bcopy((unsigned char*) newDirectoryItem, (unsigned char*) &buffer[byteStart], sizeof(DirectoryItem));
-    for(int i = blockStart; i < blockEnd + 1; i++) {
-        block_write(inode->direct[i], &buffer[(i - blockStart) * BLOCK_SIZE]);
-    }
+char* dir_load_fixed_items(Inode* inode, int* numItems, int* numBlocks) {
+    /* Lê as entradas de tamanho fixo de um diretório ainda não convertido */
+    int size = inode_data_size(inode);
+    char* items;
 
-    inode->size += sizeof(DirectoryItem);
-    save_inode(inode, superblock->workingDirectory);
+    *numItems = size / sizeof(DirectoryItem);
+    *numBlocks = (size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    items = (char*) malloc(*numBlocks * BLOCK_SIZE * sizeof(char));
 
-    /* Libera memória alocada dinamicamente */
-    free(buffer);
-    free(newInode);
-    free(inode);
+    read_n_blocks(inode, items, 0, *numBlocks - 1);
 
-    return newDirectoryItem;
+    for(int j = 0; j < *numItems; j++)
+        ((DirectoryItem*) &items[j * sizeof(DirectoryItem)])->name[MAX_FILE_NAME - 1] = '\0';
+
+    return items;
 }
 
-int fd_exists(char* fileName) {
-    /* Variável de controle */
-    int index = -1;
+int dir_records_blocks(char* items, int numItems, char* block) {
+    /* Quantos blocos as entradas ocupam como registros; registros com nomes longos podem precisar de um bloco a mais */
+    int numBlocks = 1;
 
-    /* Percorre todas as posições do vetor de descritores de arquivos */
-    for(int i = 0; i < FD_TABLE_SIZE; i++) {
-        /* Verifica se a posição tem um descritor válido e se esse tem o mesmo nome de arquivo que fileName */
-        if(fdTable[i] != NULL && same_string(fileName, fdTable[i]->name) && fdTable[i]->directoryInode == superblock->workingDirectory) {
-            /* Atualiza a variável de controle para guardar a posição do vetor que já contém um descritor de arquivo aberto para o arquivo fileName */
-            index = i;
+    dir_block_init(block);
 
-            /* Encerra o loop */
-            break;
+    for(int j = 0; j < numItems; j++) {
+        DirectoryItem* item = (DirectoryItem*) &items[j * sizeof(DirectoryItem)];
+
+        if(dir_block_insert(block, item->name, item->inode, FILE_TYPE) == -1) {
+            numBlocks++;
+            dir_block_init(block);
+            dir_block_insert(block, item->name, item->inode, FILE_TYPE);
         }
     }
 
-    /* Retorna o índice do descritor ou -1 caso ainda não haja um descritor aberto para o arquivo com nome igual a fileName */
-    return index;
+    return numBlocks;
 }
 
-void read_n_blocks(int addresses[], char* buffer, int blockStart, int blockEnd) {
-    int singleIndirectBlockStart = blockStart;
+int convert_directories() {
+    /* Reescreve as entradas de tamanho fixo de todos os diretórios como registros de tamanho variável; retorna -1,
+       sem alterar os diretórios, se não há blocos livres para os registros que não cabem nos blocos antigos */
+    char* block = (char*) malloc(BLOCK_SIZE * sizeof(char));
+    int failed = 0;
 
-    for(int i = blockStart; i < blockEnd + 1 && i < 10; i++) {
-        block_read(addresses[i + 1], &buffer[(i - blockStart) * BLOCK_SIZE]);
+    /* Antes de alterar qualquer diretório, aloca os blocos que os registros vão ocupar além dos blocos atuais */
+    for(int i = 0; i < NUMBER_OF_INODES && !failed; i++) {
+        if(!bitmap_test(&inodeBitmap, i))
+            continue;
 
-        singleIndirectBlockStart++;
-    }
+        Inode* inode = find_inode(i);
 
-    /* Lê os blocos de dados onde será feita a escrita e guarda no buffer */
-    for(int i = singleIndirectBlockStart; i < blockEnd + 1 && i < 138; i++) {
-        block_read(addresses[i + 1], &buffer[(i - blockStart) * BLOCK_SIZE]);
-    }
-}
+        if(inode->type == DIRECTORY) {
+            int numItems, oldBlocks;
+            char* items = dir_load_fixed_items(inode, &numItems, &oldBlocks);
+            int numBlocks = dir_records_blocks(items, numItems, block);
 
-void write_n_blocks(int addresses[], char* buffer, int blockStart, int blockEnd) {
-    int singleIndirectBlockStart = blockStart;
+            for(int j = oldBlocks; j < numBlocks && !failed; j++)
+                failed = bmap_alloc(inode, i, j, j) == 0;
 
-    for(int i = blockStart; i < blockEnd + 1 && i < 10; i++) {
-        block_write(addresses[i + 1], &buffer[(i - blockStart) * BLOCK_SIZE]);
+            save_inode(inode, i);
+            free(items);
+        }
 
-        singleIndirectBlockStart++;
+        release_inode(inode);
     }
 
-    /* Lê os blocos de dados onde será feita a escrita e guarda no buffer */
-    for(int i = singleIndirectBlockStart; i < blockEnd + 1 && i < 138; i++) {
-        block_write(addresses[i + 1], &buffer[(i - blockStart) * BLOCK_SIZE]);
+    /* Sem espaço, devolve os blocos alocados (o tamanho dos diretórios não mudou) e mantém o formato antigo */
+    if(failed) {
+        for(int i = 0; i < NUMBER_OF_INODES; i++) {
+            if(!bitmap_test(&inodeBitmap, i))
+                continue;
+
+            Inode* inode = find_inode(i);
+
+            if(inode->type == DIRECTORY) {
+                bmap_truncate(inode, (inode_data_size(inode) + BLOCK_SIZE - 1) / BLOCK_SIZE);
+                save_inode(inode, i);
+            }
+
+            release_inode(inode);
+        }
+
+        free(block);
+        return -1;
     }
-}
 
-void fill_with_zero_bytes(Inode* inode, File* fd) {
-    /* Calcula os blocos de inicio e término da escrita e byte de início */
-    int blockStart = inode->size / BLOCK_SIZE;
-    int blockEnd = (fd->offset - 1) / BLOCK_SIZE;
-    int byteStart = inode->size % BLOCK_SIZE;
+    for(int i = 0; i < NUMBER_OF_INODES; i++) {
+        if(!bitmap_test(&inodeBitmap, i))
+            continue;
 
-    /* Vetor para guardar os possíveis números de blocos de dados */
-    int addresses[139];
+        Inode* inode = find_inode(i);
 
-    /* Inicializa todos com -1 */
-    for(int i = 0; i < 139; i++)
-        addresses[i] = -1;
+        if(inode->type != DIRECTORY) {
+            release_inode(inode);
+            continue;
+        }
 
-    /* Atribui a primeira ao número do bloco do single indirect */
-    addresses[0] = inode->singleIndirect;
+        /* Carrega as entradas antigas e descarta o índice, que aponta para elas */
+        int numItems, oldBlocks;
+        char* items = dir_load_fixed_items(inode, &numItems, &oldBlocks);
 
-    /* Copia os números dos blocos de dados diretos */
-    for(int i = 1; i < 11; i++)
-        addresses[i] = inode->direct[i - 1];
+        dir_index_free(inode);
 
-    /* Copia os números dos blocos de dados indiretos simples */
-    if(inode->singleIndirect != -1) {
-        AddressBlock* addressBlock = (AddressBlock*) malloc(sizeof(AddressBlock));
-        char* buffer = (char*) malloc(BLOCK_SIZE * sizeof(char));
+        /* Preenche os blocos em ordem, que já estão todos alocados */
+        int numBlocks = 0;
 
-        block_read(inode->singleIndirect, buffer);
+        dir_block_init(block);
 
-        bcopy((unsigned char*) buffer, (unsigned char*) addressBlock, sizeof(AddressBlock));
+        for(int j = 0; j < numItems; j++) {
+            DirectoryItem* item = (DirectoryItem*) &items[j * sizeof(DirectoryItem)];
+            Inode* itemInode = find_inode(item->inode);
+            int fileType = FILE_TYPE;
 
-        for(int i = 11; i < 139; i++)
-            addresses[i] = addressBlock->singleIndirect[i - 11];
+            /* Uma entrada com número de inode inválido é mantida como arquivo */
+            if(itemInode != NULL) {
+                fileType = itemInode->type;
+                release_inode(itemInode);
+            }
 
-        free(buffer);
-        free(addressBlock);
+            if(dir_block_insert(block, item->name, item->inode, fileType) == -1) {
+                bcache_write(bmap(inode, numBlocks++), block);
+                dir_block_init(block);
+                dir_block_insert(block, item->name, item->inode, fileType);
+            }
+        }
+
+        bcache_write(bmap(inode, numBlocks++), block);
+
+        bmap_truncate(inode, numBlocks);
+        inode_set_data_size(inode, numBlocks * BLOCK_SIZE);
+
+        /* Recria o índice com as novas posições (também salva o inode) */
+        dir_index_build(inode, i);
+
+        free(items);
+        release_inode(inode);
     }
 
-    /* Carrega mapa de bits dos blocos de dados */
-    char dmap[D_MAP_SIZE];
-    load_bitmap(dmap, D_MAP_BLOCK);
+    superblock->dirFormat = DIR_FORMAT_RECORDS;
 
-    /* Variáveis de controle */
-    int blockNumber;
-    int blockCount = 0;
+    /* Grava o superbloco com o novo formato */
+    bzero(block, BLOCK_SIZE);
+    bcopy((unsigned char*) superblock, (unsigned char*) block, sizeof(Superblock));
+    bcache_write(SUPERBLOCK_BLOCK_NUMBER, block);
 
-    /* Aloca blocos de dados para a escrita */
-    for(int i = blockStart; i < blockEnd + 1 && i < 138; i++) {
-        /* Verifica se não há um bloco de dados alocado ni i-ésimo ponteiro direto */
-        if(addresses[i + 1] == -1) {
-            /* Busca um bloco de dados livre */
-            blockNumber = find_free_bit_number(dmap, D_MAP_SIZE);
+    free(block);
 
-            /* Verifica se foi possível encontrar um bloco de dados disponível */
-            if(blockNumber == -1)
-                break;
+    return 0;
+}
 
-            /* Verifica se está sendo alocado um bloco para o single indirect */
-            if(i == 10 && addresses[0] == -1) {
-                addresses[0] = blockNumber + DATA_BLOCK_START;
-                i--;
-                blockCount--;
-            } else {
-                /* Atualiza o i-ésimo ponteiro com o número do bloco de dados livre encontrado */
-                addresses[i + 1] = blockNumber + DATA_BLOCK_START;
-            }
-        }
+DirectoryItem* create_new_file(int dirInodeNumber, char* fileName) {
+    DirectoryItem* newDirectoryItem = NULL;
 
-        /* Incrementa a quantidade de blocos necessários para realizar a escrita */
-        blockCount++;
+    /* Verifica se já existe um diretório/arquivo com o mesmo nome */
+    if(item_exists(dirInodeNumber, fileName)) {
+        return NULL;
     }
 
-    /* Calcula quantos bytes estão disponíveis para escrita */
-    int bytesCount = blockCount * BLOCK_SIZE - byteStart;
+    /* Encontra inode livre no grupo do diretório */
+    int inodeNumber = alloc_inode(dirInodeNumber, 0);
 
-    /* Aloca memória para a variável buffer */
-    char* buffer = (char*) malloc(blockCount * BLOCK_SIZE * sizeof(char));
+    /* Checa se houve sucesso em encontrar um inode livre */
+    if(inodeNumber == -1)
+        return NULL;
 
-    /* Lê os blocos de dados onde será feita a escrita e guarda no buffer */
-    read_n_blocks(addresses, buffer, blockStart, blockEnd);
+    /* Aloca inode para o novo arquivo criado */
+    Inode* newInode = create_new_inode();
+    newInode->type = FILE_TYPE;
 
-    bzero(&buffer[byteStart], bytesCount);
+    /* O arquivo começa vazio com os dados no próprio inode, até crescer além de INODE_INLINE_SIZE bytes */
+    newInode->flags = INODE_FLAG_INLINE;
 
-    /* Escreve os bytes do buffer nos blocos de dados correspondente ao do arquivo */
-    write_n_blocks(addresses, buffer, blockStart, blockEnd);
+    newDirectoryItem = (DirectoryItem*) malloc(sizeof(DirectoryItem));
+    bcopy((unsigned char*) fileName, (unsigned char*) newDirectoryItem->name, strlen(fileName) + 1);
+    newDirectoryItem->inode = inodeNumber;
 
-    /* Libera memória alocada dinâmicamente */
-    free(buffer);
+    /* Guarda o novo arquivo criado no fim do diretório */
+    if(append_directory_item(dirInodeNumber, newDirectoryItem, FILE_TYPE) != 0) {
+        free_bit(&inodeBitmap, inodeNumber);
+        free(newDirectoryItem);
+        free(newInode);
+        return NULL;
+    }
+
+    /* Salva o inode correspondente ao arquivo no disco */
+    save_inode(newInode, inodeNumber);
+
+    /* Libera memória alocada dinamicamente */
+    free(newInode);
 
-    int additionalBytes = 0;
+    return newDirectoryItem;
+}
 
-    /* Adiciona BLOCK_SIZE bytes se o arquivo passou a ter um bloco indireto */
-    if(inode->singleIndirect == -1 && addresses[0] != -1)
-        additionalBytes = BLOCK_SIZE;
+void fill_file_stat(Inode* inode, int inodeNumber, fileStat* buf) {
+    /* Copia as informações sobre o arquivo/diretório para buf */
+    buf->inodeNo = inodeNumber;
+    buf->type = inode->type;
+    buf->links = inode->linkCount;
+    buf->size = inode_data_size(inode);
+    buf->numBlocks = bmap_blocks(inode);
+}
 
-    /* Atualiza o valor do bloco que contém os ponteiros indiretos */
-    inode->singleIndirect = addresses[0];
+int compare_inode_refs(const void* a, const void* b) {
+    return ((InodeRef*) a)->inode - ((InodeRef*) b)->inode;
+}
 
-    /* Atualiza os blocos de dados diretos */
-    for(int i = 1; i < 11; i++)
-        inode->direct[i - 1] = addresses[i];
+int fd_exists(int dirInodeNumber, int inodeNumber) {
+    /* Percorre apenas os descritores abertos para o mesmo inode */
+    int fd = fdHash[inodeNumber % FD_TABLE_SIZE];
 
-    /* Atualiza os blocos de dados indiretos */
-    if(inode->singleIndirect != -1) {
-        AddressBlock* addressBlock = (AddressBlock*) malloc(sizeof(AddressBlock));
-        char* buffer = (char*) malloc(BLOCK_SIZE * sizeof(char));
+    while(fd != -1 && (fdTable[fd]->inode != inodeNumber || fdTable[fd]->directoryInode != dirInodeNumber))
+        fd = fdHashNext[fd];
 
-        for(int i = 11; i < 139; i++)
-            addressBlock->singleIndirect[i - 11] = addresses[i];
+    /* Retorna o índice do descritor ou -1 caso ainda não haja um descritor aberto para o arquivo no diretório */
+    return fd;
+}
 
-        bcopy((unsigned char*) addressBlock, (unsigned char*) buffer, sizeof(AddressBlock));
+void fill_with_zero_bytes(Inode* inode, File* fd) {
+    int size = inode_data_size(inode);
 
-        block_write(inode->singleIndirect, buffer);
+    /* Calcula os blocos de inicio e término da escrita e byte de início */
+    int blockStart = size / BLOCK_SIZE;
+    int blockEnd = (fd->offset - 1) / BLOCK_SIZE;
+    int byteStart = size % BLOCK_SIZE;
 
-        free(buffer);
-        free(addressBlock);
-    }
+    /* Aloca blocos de dados contíguos para a escrita */
+    int blockCount = bmap_alloc(inode, fd->inode, blockStart, blockEnd);
 
-    /* Calcula o número esperado de bytes */
-    int expected = fd->offset - inode->size;
+    /* Não há espaço para nenhum bloco */
+    if(blockCount == 0)
+        return;
 
-    /* Verifica se foi escrito o número esperado de bytes */
-    if(expected <= bytesCount) {
-        inode->size = fd->offset;
-    } else {
-        inode->size += bytesCount;
-    }
+    /* Calcula quantos bytes estão disponíveis para escrita */
+    int bytesCount = blockCount * BLOCK_SIZE - byteStart;
+
+    /* Aloca memória para a variável buffer */
+    char* buffer = (char*) malloc(blockCount * BLOCK_SIZE * sizeof(char));
 
-    /* Soma bytes adicional (bloco indireto) ao tamanho do arquivo */
-    inode->size += additionalBytes;
+    /* Lê os blocos de dados onde será feita a escrita e guarda no buffer */
+    read_file_blocks(fd, buffer, blockStart, blockStart + blockCount - 1);
+
+    bzero(&buffer[byteStart], bytesCount);
 
-    /* Salva mapa de bits dos blocos de dados */
-    save_bitmap(dmap, D_MAP_BLOCK);
-}
\ No newline at end of file
+    /* Escreve os bytes do buffer nos blocos de dados correspondente ao do arquivo */
+    write_file_blocks(fd, buffer, blockStart, blockStart + blockCount - 1);
+
+    /* Libera memória alocada dinâmicamente */
+    free(buffer);
+
+    /* Verifica se foi escrito o número esperado de bytes */
+    if(fd->offset - size <= bytesCount)
+        inode_set_data_size(inode, fd->offset);
+    else
+        inode_set_data_size(inode, size + bytesCount);
+}
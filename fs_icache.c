@@ -0,0 +1,321 @@
+/* Cache de inodes em memória
+
+   find_inode empresta uma entrada da cache (contagem de referências) em vez de
+   devolver uma cópia: quem chama deve devolvê-la com release_inode e não pode
+   liberá-la com free. save_inode apenas marca a entrada como suja; as entradas
+   sujas são escritas no disco por flush_inodes agrupadas por bloco da tabela de
+   inodes, ou individualmente quando são removidas da cache. */
+
+#define ICACHE_SIZE 128
+#define ICACHE_HASH_SIZE 64
+
+typedef struct CachedInode {
+    Inode inode;                    /* precisa ser o primeiro campo (Inode* -> CachedInode*) */
+    int number;
+    int refCount;
+    int dirty;
+    struct CachedInode* hashNext;
+    struct CachedInode* lruPrev;
+    struct CachedInode* lruNext;
+} CachedInode;
+
+CachedInode* icacheHash[ICACHE_HASH_SIZE];
+
+/* Lista LRU das entradas sem referências (candidatas a serem reaproveitadas) */
+CachedInode* icacheLruHead = NULL;
+CachedInode* icacheLruTail = NULL;
+
+/* Lista de todas as entradas alocadas (para flush e invalidação) */
+CachedInode** icacheEntries = NULL;
+int icacheCount = 0;
+int icacheCapacity = 0;
+
+void icache_lru_remove(CachedInode* entry) {
+    if(entry->lruPrev != NULL)
+        entry->lruPrev->lruNext = entry->lruNext;
+    else if(icacheLruHead == entry)
+        icacheLruHead = entry->lruNext;
+    else
+        return;
+
+    if(entry->lruNext != NULL)
+        entry->lruNext->lruPrev = entry->lruPrev;
+    else
+        icacheLruTail = entry->lruPrev;
+
+    entry->lruPrev = NULL;
+    entry->lruNext = NULL;
+}
+
+void icache_lru_push_front(CachedInode* entry) {
+    entry->lruPrev = NULL;
+    entry->lruNext = icacheLruHead;
+
+    if(icacheLruHead != NULL)
+        icacheLruHead->lruPrev = entry;
+    else
+        icacheLruTail = entry;
+
+    icacheLruHead = entry;
+}
+
+void icache_hash_remove(CachedInode* entry) {
+    CachedInode** link = &icacheHash[entry->number % ICACHE_HASH_SIZE];
+
+    while(*link != NULL && *link != entry)
+        link = &(*link)->hashNext;
+
+    if(*link == entry)
+        *link = entry->hashNext;
+
+    entry->hashNext = NULL;
+}
+
+CachedInode* icache_lookup(int inodeNumber) {
+    CachedInode* entry = icacheHash[inodeNumber % ICACHE_HASH_SIZE];
+
+    while(entry != NULL && entry->number != inodeNumber)
+        entry = entry->hashNext;
+
+    return entry;
+}
+
+/* Calcula a posição (em bytes) do inode dentro da tabela de inodes, que passa de 2 GB em discos com dezenas de milhões de inodes */
+long long inode_offset(int inodeNumber) {
+    return (long long) inodeNumber * sizeof(Inode);
+}
+
+void write_inode_to_disk(CachedInode* entry) {
+    /* Aloca memória para a variável buffer */
+    char* buffer_ = (char*) malloc(2 * BLOCK_SIZE * sizeof(char));
+
+    /* Calcula em quais blocos está o inode a ser salvo */
+    long long start = inode_offset(entry->number);
+    int blockStart = (int) (start / BLOCK_SIZE);
+    int blockEnd = (int) ((start + sizeof(Inode) - 1) / BLOCK_SIZE);
+
+    /* Lê os blocos, copia o inode na posição correspondente e escreve os blocos de volta */
+    for(int i = blockStart; i < blockEnd + 1; i++)
+        bcache_read(i + INODE_START, &buffer_[(i - blockStart) * BLOCK_SIZE]);
+
+    bcopy((unsigned char*) &entry->inode, (unsigned char*) &buffer_[start % BLOCK_SIZE], sizeof(Inode));
+
+    for(int i = blockStart; i < blockEnd + 1; i++)
+        bcache_write(i + INODE_START, &buffer_[(i - blockStart) * BLOCK_SIZE]);
+
+    entry->dirty = 0;
+
+    /* Libera memória alocada dinâmicamente */
+    free(buffer_);
+}
+
+/* Obtém uma entrada para o inode, reaproveitando a menos usada recentemente quando a cache está cheia */
+CachedInode* icache_get_entry(int inodeNumber) {
+    CachedInode* entry;
+
+    if(icacheCount >= ICACHE_SIZE && icacheLruTail != NULL) {
+        /* Reaproveita a entrada sem referências usada há mais tempo */
+        entry = icacheLruTail;
+        icache_lru_remove(entry);
+
+        if(entry->dirty)
+            write_inode_to_disk(entry);
+
+        icache_hash_remove(entry);
+    } else {
+        /* Aloca uma nova entrada (a cache pode passar de ICACHE_SIZE se todas estiverem em uso) */
+        entry = (CachedInode*) malloc(sizeof(CachedInode));
+        entry->lruPrev = NULL;
+        entry->lruNext = NULL;
+
+        if(icacheCount == icacheCapacity) {
+            icacheCapacity = icacheCapacity == 0 ? ICACHE_SIZE : 2 * icacheCapacity;
+            icacheEntries = (CachedInode**) realloc(icacheEntries, icacheCapacity * sizeof(CachedInode*));
+        }
+
+        icacheEntries[icacheCount++] = entry;
+    }
+
+    entry->number = inodeNumber;
+    entry->refCount = 0;
+    entry->dirty = 0;
+    entry->hashNext = icacheHash[inodeNumber % ICACHE_HASH_SIZE];
+    icacheHash[inodeNumber % ICACHE_HASH_SIZE] = entry;
+
+    return entry;
+}
+
+Inode* find_inode(int inodeNumber) {
+    /* Verifica se o número de inode é um número válido */
+    if(inodeNumber < 0 || inodeNumber > NUMBER_OF_INODES - 1)
+        return NULL;
+
+    CachedInode* entry = icache_lookup(inodeNumber);
+
+    if(entry == NULL) {
+        entry = icache_get_entry(inodeNumber);
+
+        /* Aloca memória para a variável buffer */
+        char* buffer = (char*) malloc(2 * BLOCK_SIZE * sizeof(char));
+
+        /* Calcula em quais blocos está o inode a ser encontrado */
+        long long start = inode_offset(inodeNumber);
+        int blockStart = (int) (start / BLOCK_SIZE);
+        int blockEnd = (int) ((start + sizeof(Inode) - 1) / BLOCK_SIZE);
+
+        /* Copia os blocos para a variável buffer */
+        for(int i = blockStart; i < blockEnd + 1; i++) {
+            bcache_read(i + INODE_START, &buffer[(i - blockStart) * BLOCK_SIZE]);
+        }
+
+        /* Copia os bytes do buffer para a entrada da cache */
+        bcopy((unsigned char*) &buffer[start % BLOCK_SIZE], (unsigned char*) &entry->inode, sizeof(Inode));
+
+        /* Libera memória alocada */
+        free(buffer);
+    } else if(entry->refCount == 0) {
+        /* A entrada volta a estar em uso e deixa a lista LRU */
+        icache_lru_remove(entry);
+    }
+
+    entry->refCount++;
+
+    /* Retorna a referência emprestada para o inode encontrado */
+    return &entry->inode;
+}
+
+void release_inode(Inode* inode) {
+    /* A entrada começa pelo próprio inode, então basta converter o endereço */
+    char* address = (char*) inode;
+    CachedInode* entry = (CachedInode*) address;
+
+    if(inode == NULL)
+        return;
+
+    /* Entradas sem referências passam a poder ser reaproveitadas */
+    if(--entry->refCount == 0)
+        icache_lru_push_front(entry);
+}
+
+void save_inode(Inode* inode, int inodeNumber) {
+    CachedInode* entry = icache_lookup(inodeNumber);
+
+    /* Inodes novos (criados com create_new_inode) ainda não estão na cache */
+    if(entry == NULL) {
+        entry = icache_get_entry(inodeNumber);
+        icache_lru_push_front(entry);
+    }
+
+    /* Copia o inode para a entrada se não for a própria entrada emprestada */
+    if(&entry->inode != inode)
+        bcopy((unsigned char*) inode, (unsigned char*) &entry->inode, sizeof(Inode));
+
+    entry->dirty = 1;
+}
+
+int compare_cached_inodes(const void* a, const void* b) {
+    return (*(CachedInode**) a)->number - (*(CachedInode**) b)->number;
+}
+
+void flush_inodes() {
+    CachedInode** dirty = (CachedInode**) malloc((icacheCount + 1) * sizeof(CachedInode*));
+    int count = 0;
+
+    /* Seleciona as entradas sujas em ordem de número de inode */
+    for(int i = 0; i < icacheCount; i++) {
+        if(icacheEntries[i]->dirty)
+            dirty[count++] = icacheEntries[i];
+    }
+
+    qsort(dirty, count, sizeof(CachedInode*), compare_cached_inodes);
+
+    int index = 0;
+    int block = -1;
+
+    /* Escreve cada bloco da tabela de inodes uma única vez com todos os inodes sujos que ele contém */
+    while(index < count) {
+        /* Um inode que atravessa o fim do bloco anterior continua no bloco seguinte */
+        if(block < inode_offset(dirty[index]->number) / BLOCK_SIZE)
+            block = (int) (inode_offset(dirty[index]->number) / BLOCK_SIZE);
+
+        long long blockBegin = (long long) block * BLOCK_SIZE;
+        long long blockEnd = blockBegin + BLOCK_SIZE;
+
+        /* Copia para o bloco na cache a parte de cada inode sujo que cai dentro dele */
+        for(int i = index; i < count && inode_offset(dirty[i]->number) < blockEnd; i++) {
+            long long start = inode_offset(dirty[i]->number);
+            long long end = start + sizeof(Inode);
+            long long from = start > blockBegin ? start : blockBegin;
+            long long to = end < blockEnd ? end : blockEnd;
+
+            bcache_update(block + INODE_START, (int) (from - blockBegin), (char*) &dirty[i]->inode + (from - start), (int) (to - from));
+        }
+
+        /* Descarta os inodes que terminam dentro deste bloco */
+        while(index < count && inode_offset(dirty[index]->number) + (long long) sizeof(Inode) <= blockEnd) {
+            dirty[index]->dirty = 0;
+            index++;
+        }
+
+        block++;
+    }
+
+    /* Libera memória alocada dinâmicamente */
+    free(dirty);
+}
+
+void read_inodes(int* numbers, Inode* out, int count) {
+    /* Copia os inodes numbers (em ordem crescente) para out lendo cada bloco da tabela de inodes uma única vez.
+       Os inodes que estão na cache são copiados dela, pois podem ter alterações ainda não escritas, e os
+       demais não entram na cache, para que uma listagem grande não descarte os inodes em uso. */
+    char* window = (char*) malloc(2 * BLOCK_SIZE * sizeof(char));
+    int first = -1;
+    int loaded = 0;
+
+    for(int i = 0; i < count; i++) {
+        CachedInode* entry = icache_lookup(numbers[i]);
+
+        if(entry != NULL) {
+            out[i] = entry->inode;
+            continue;
+        }
+
+        long long start = inode_offset(numbers[i]);
+        int blockStart = (int) (start / BLOCK_SIZE);
+        int blockEnd = (int) ((start + sizeof(Inode) - 1) / BLOCK_SIZE);
+
+        /* Lê apenas os blocos que ainda não estão na janela, mantendo o último bloco lido */
+        if(first == -1 || blockStart < first || blockEnd >= first + loaded) {
+            if(first != -1 && blockStart == first + loaded - 1) {
+                bcopy((unsigned char*) &window[(loaded - 1) * BLOCK_SIZE], (unsigned char*) window, BLOCK_SIZE);
+                loaded = 1;
+            } else {
+                loaded = 0;
+            }
+
+            first = blockStart;
+
+            while(first + loaded <= blockEnd) {
+                bcache_read(first + loaded + INODE_START, &window[loaded * BLOCK_SIZE]);
+                loaded++;
+            }
+        }
+
+        bcopy((unsigned char*) &window[start - (long long) first * BLOCK_SIZE], (unsigned char*) &out[i], sizeof(Inode));
+    }
+
+    free(window);
+}
+
+void invalidate_inodes() {
+    /* Descarta todas as entradas sem escrevê-las (usado ao formatar o disco) */
+    for(int i = 0; i < icacheCount; i++)
+        free(icacheEntries[i]);
+
+    for(int i = 0; i < ICACHE_HASH_SIZE; i++)
+        icacheHash[i] = NULL;
+
+    icacheCount = 0;
+    icacheLruHead = NULL;
+    icacheLruTail = NULL;
+}
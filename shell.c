@@ -4,6 +4,8 @@
 
 #ifdef FAKE
 #define START main
+#include "block.h"
+#include "bcache.h"
 #include "fs.h"
 #include <stdlib.h>
 #else
@@ -35,8 +37,14 @@ static void shell_cd( void);
 static void shell_link( void);
 static void shell_unlink( void);
 static void shell_stat( void);
+static void shell_df( void);
+static void shell_dcache( void);
+static void shell_bcache( void);
 
 static void shell_ls( void);
+static void shell_opendir( void);
+static void shell_readdir( void);
+static void shell_closedir( void);
 static void shell_create( void);
 static void shell_cat( void);
 
@@ -67,7 +75,7 @@ int START(void) {
 		EXEC_COMMAND( "exit",   1,  1, "", shell_exit());
 		EXEC_COMMAND( "fire",   1,  1, "", shell_fire());
 		EXEC_COMMAND( "clear",  1,  1, "", shell_clearscreen());
-		EXEC_COMMAND( "mkfs",   1,  1, "", shell_mkfs());
+		EXEC_COMMAND( "mkfs",   1, 12, " [-b blocksize] [-e] [-s size[K|M|G]] [-i bytes-per-inode] [-g blocks-per-group] [-f open-files]", shell_mkfs());
 		EXEC_COMMAND( "open",   3,  3, "", shell_open());
 		EXEC_COMMAND( "read",   3,  3, "", shell_read());
 		EXEC_COMMAND( "write",  3,  3, "", shell_write());
@@ -79,7 +87,13 @@ int START(void) {
 		EXEC_COMMAND( "link",   3,  3, "", shell_link());
 		EXEC_COMMAND( "unlink", 2,  2, "", shell_unlink());
 		EXEC_COMMAND( "stat",   2,  2, "", shell_stat());
-		EXEC_COMMAND( "ls",     1,  2, "", shell_ls());
+		EXEC_COMMAND( "df",     1,  1, "", shell_df());
+		EXEC_COMMAND( "dcache", 1,  1, "", shell_dcache());
+		EXEC_COMMAND( "bcache", 1,  1, "", shell_bcache());
+		EXEC_COMMAND( "opendir",  2,  2, "", shell_opendir());
+		EXEC_COMMAND( "readdir",  2,  2, "", shell_readdir());
+		EXEC_COMMAND( "closedir", 2,  2, "", shell_closedir());
+		EXEC_COMMAND( "ls",     1,  2, " [-l]", shell_ls());
 		EXEC_COMMAND( "create", 3,  3, "", shell_create());
 		EXEC_COMMAND( "cat",    2,  2, "", shell_cat());
 		EXEC_COMMAND( "list",   1,  1, "", shell_listproc());
@@ -146,9 +160,67 @@ static void shell_clearscreen( void) {
 	clearShellScreen();
 }
 
+#ifdef FAKE
+/* Converts a size such as 512, 64K, 100M or 20G to bytes */
+static long long parse_size( char *s) {
+	long long size = 0;
+
+	for ( ; *s >= '0' && *s <= '9'; s++)
+		size = size * 10 + (*s - '0');
+
+	if (*s == 'K' || *s == 'k')
+		size <<= 10;
+	else if (*s == 'M' || *s == 'm')
+		size <<= 20;
+	else if (*s == 'G' || *s == 'g')
+		size <<= 30;
+
+	return size;
+}
+#endif
+
 static void shell_mkfs( void) {
+#ifdef FAKE
+	MkfsOptions options;
+	long long size = 0;
+	int i;
+
+	options.blockSize = 512;
+	options.inodeFormat = INODE_FORMAT_POINTERS;
+	options.numBlocks = 0;
+	options.bytesPerInode = 0;
+	options.blocksPerGroup = 0;
+	options.fdTableSize = 0;
+
+	for (i = 1; i < argc; i++) {
+		if (same_string(argv[i], "-b") && i + 1 < argc)
+			options.blockSize = atoi(argv[++i]);
+		else if (same_string(argv[i], "-e"))
+			options.inodeFormat = INODE_FORMAT_EXTENTS;
+		else if (same_string(argv[i], "-s") && i + 1 < argc)
+			size = parse_size(argv[++i]);
+		else if (same_string(argv[i], "-i") && i + 1 < argc)
+			options.bytesPerInode = atoi(argv[++i]);
+		else if (same_string(argv[i], "-g") && i + 1 < argc)
+			options.blocksPerGroup = atoi(argv[++i]);
+		else if (same_string(argv[i], "-f") && i + 1 < argc)
+			options.fdTableSize = atoi(argv[++i]);
+		else {
+			usage(" [-b blocksize] [-e] [-s size[K|M|G]] [-i bytes-per-inode] [-g blocks-per-group] [-f open-files]");
+			return;
+		}
+	}
+
+	/* The image size is given in bytes and converted once the block size is known */
+	if (size > 0 && options.blockSize > 0)
+		options.numBlocks = size / options.blockSize > 0x7FFFFFFF ? 0x7FFFFFFF : size / options.blockSize;
+
+	if (fs_mkfs_with(&options) != 0)
+		writeStr("mkfs failed\n");
+#else
 	if (fs_mkfs() != 0)
 		writeStr("mkfs failed\n");
+#endif
 }
 
 static void shell_create( void) {
@@ -247,31 +319,104 @@ static void shell_cd( void) {
 }
 
 static void shell_ls( void) {
+#ifdef FAKE
+	dirEntryPlus entries[READDIR_BATCH];
+	char s[10];
+	int dd, n, i, j;
+
+	if ( argc == 1) {
+		//should a system call print to the screen?
+		if(fs_ls() == -1)
+			writeStr("Problem with ls\n");
+		return;
+	}
+
+	if ( !same_string( argv[1], "-l")) {
+		usage( " [-l]");
+		return;
+	}
+
+	/* Long listing: the attributes come with the entries, in one pass over the inode table */
+	dd = fs_opendir( ".");
+	if ( dd < 0) {
+		writeStr("Problem with ls\n");
+		return;
+	}
+
+	writeStr( "Name");
+	for ( j = 0; j < MAX_FILE_NAME - 3; j++) writeChar( ' ');
+	writeStr( "Type Inode Size\n");
+
+	while ( ( n = fs_readdir_plus( dd, entries, READDIR_BATCH)) > 0) {
+		for ( i = 0; i < n; i++) {
+			writeStr( entries[i].name);
+			for ( j = strlen( entries[i].name); j < MAX_FILE_NAME + 1; j++) writeChar( ' ');
+			writeStr( entries[i].stat.type == DIRECTORY ? "D" : "F");
+			writeStr( "    ");
+			itoa( entries[i].stat.inodeNo, s);
+			writeStr( s);
+			writeStr( "     ");
+			itoa( entries[i].stat.size, s);
+			writeStr( s);
+			writeChar( RETURN);
+		}
+	}
+
+	fs_closedir( dd);
+#else
 	//should a system call print to the screen?
 	if(fs_ls() == -1)
 		writeStr("Problem with ls\n");
-	
-//Code/pseudocode you can use somewhere to get the same ls output as the tests
-//  writeStr("Name");
-//  print MAX_FILE_NAME - 3 spaces
-//  writeStr("Type");
-//  print 1 space
-//  writeStr("Inode");
-//  print 1 space
-//  writeStr("Size\n");
-
-
-//  writeStr(/*file name*/);
-//  print MAX_FILE_NAME - size of file name + 1 spaces
-//
-//  writeStr(/*condition*/ ? "D" : "F");
-//  print 4 spaces
-//
-//  writeInt(/*inode #*/);
-//  print 5 spaces
-//
-//  writeInt(/*file size*/);
-//  writeStr("\n");
+#endif
+}
+
+static void shell_opendir( void) {
+#ifdef FAKE
+	int dd;
+	char s[10];
+
+	if ( ( dd = fs_opendir( argv[1])) == -1)
+		writeStr( "Error while opening directory\n");
+	else {
+		itoa( dd, s);
+		writeStr( "Directory handle is : ");
+		writeStr( s);
+		writeChar( RETURN);
+	}
+#else
+	writeStr( "Error while opening directory\n");
+#endif
+}
+
+/* Prints the next batch of entries of an open directory */
+static void shell_readdir( void) {
+#ifdef FAKE
+	dirEntryPlus entries[READDIR_BATCH];
+	int i, n;
+
+	if ( ( n = fs_readdir_plus( atoi( argv[1]), entries, READDIR_BATCH)) == -1)
+		writeStr( "Readdir failed\n");
+	else if ( n == 0)
+		writeStr( "End of directory\n");
+	else
+		for ( i = 0; i < n; i++) {
+			writeStr( entries[i].name);
+			writeChar( RETURN);
+		}
+#else
+	writeStr( "Readdir failed\n");
+#endif
+}
+
+static void shell_closedir( void) {
+#ifdef FAKE
+	if ( fs_closedir( atoi( argv[1])) == -1)
+		writeStr( "Error while closing directory\n");
+	else
+		writeStr( "OK\n");
+#else
+	writeStr( "Error while closing directory\n");
+#endif
 }
 
 static void shell_link( void) {
@@ -307,6 +452,81 @@ static void shell_stat( void) {
 		writeStr( "Stat failed\n");
 }
 
+static void shell_df( void) {
+#ifdef FAKE
+	fsStat status;
+	char s[10];
+
+	if ( fs_statfs( &status) == 0) {
+		itoa( status.blockSize, s);
+		writeStr( "    Block size       : "); writeStr( s); writeChar( RETURN);
+		itoa( status.totalBlocks, s);
+		writeStr( "    Data blocks      : "); writeStr( s); writeChar( RETURN);
+		itoa( status.freeBlocks, s);
+		writeStr( "    Free blocks      : "); writeStr( s); writeChar( RETURN);
+		itoa( status.totalInodes, s);
+		writeStr( "    Inodes           : "); writeStr( s); writeChar( RETURN);
+		itoa( status.freeInodes, s);
+		writeStr( "    Free inodes      : "); writeStr( s); writeChar( RETURN);
+	} else
+		writeStr( "Df failed\n");
+#else
+	writeStr( "Df failed\n");
+#endif
+}
+
+static void shell_dcache( void) {
+#ifdef FAKE
+	dcacheStat status;
+	char s[10];
+	int lookups;
+
+	if ( fs_dcache_stats( &status) == 0) {
+		lookups = status.hits + status.negativeHits + status.misses;
+		itoa( lookups, s);
+		writeStr( "    Lookups          : "); writeStr( s); writeChar( RETURN);
+		itoa( status.hits, s);
+		writeStr( "    Hits             : "); writeStr( s); writeChar( RETURN);
+		itoa( status.negativeHits, s);
+		writeStr( "    Negative hits    : "); writeStr( s); writeChar( RETURN);
+		itoa( status.misses, s);
+		writeStr( "    Misses           : "); writeStr( s); writeChar( RETURN);
+		itoa( status.evictions, s);
+		writeStr( "    Evictions        : "); writeStr( s); writeChar( RETURN);
+		itoa( lookups > 0 ? 100 * (status.hits + status.negativeHits) / lookups : 0, s);
+		writeStr( "    Hit rate         : "); writeStr( s); writeStr( "%\n");
+	} else
+		writeStr( "Dcache failed\n");
+#else
+	writeStr( "Dcache failed\n");
+#endif
+}
+
+static void shell_bcache( void) {
+#ifdef FAKE
+	BCacheStats status;
+	char s[10];
+	int accesses;
+
+	bcache_get_stats( &status);
+	accesses = status.hits + status.misses;
+	itoa( accesses, s);
+	writeStr( "    Accesses         : "); writeStr( s); writeChar( RETURN);
+	itoa( status.hits, s);
+	writeStr( "    Hits             : "); writeStr( s); writeChar( RETURN);
+	itoa( status.misses, s);
+	writeStr( "    Misses           : "); writeStr( s); writeChar( RETURN);
+	itoa( status.evictions, s);
+	writeStr( "    Evictions        : "); writeStr( s); writeChar( RETURN);
+	itoa( status.writebacks, s);
+	writeStr( "    Writebacks       : "); writeStr( s); writeChar( RETURN);
+	itoa( accesses > 0 ? (int) (100LL * status.hits / accesses) : 0, s);
+	writeStr( "    Hit rate         : "); writeStr( s); writeStr( "%\n");
+#else
+	writeStr( "Bcache failed\n");
+#endif
+}
+
 static void shell_cat( void) {
 	int fd, n, i;
 	char buf[256];
@@ -1,6 +1,6 @@
 #!/usr/bin/python
 
-import os, sys, subprocess
+import os, sys, subprocess, struct
 fs_size_bytes = 1048576
 
 def spawn_lnxsh():
@@ -281,7 +281,7 @@ def check_file_create():
     if(output.decode() == expected):
         print("Arquivo de 70656 bytes criado com sucesso")
 
-# Testa criação de um arquivo chamado arquivo.txt com o tamanho máximo (70656 bytes - usando single indirect) e exibe suas informações usando comando stat
+# Testa criação de um arquivo chamado arquivo.txt que passa dos blocos indiretos simples (usando double indirect) e exibe suas informações usando comando stat
 def check_stat():
     spawn_lnxsh()
     issue("mkfs")
@@ -294,8 +294,8 @@ def check_stat():
                 "# # #     Inode No         : 1\n"
                 "    Type             : FILE\n"
                 "    Link Count       : 1\n"
-                "    Size             : 71168\n" # 70656 bytes do arquivo + 512 bytes para alocação de um bloco para ponteiros single indirect
-                "    Blocks allocated : 139\n"
+                "    Size             : 72422\n" # 70656 letras + 1766 quebras de linha
+                "    Blocks allocated : 145\n" # 142 blocos de dados + o indireto simples + o indireto duplo e um bloco abaixo dele
                 "# Goodbye\n")
 
     if(output.decode() == expected):
@@ -353,6 +353,566 @@ def check_cd():
     if(output.decode() == expected):
         print("Comando cd executado com sucesso")
 
+# Testa a formatação do disco com blocos de 4096 bytes
+def check_mkfs_block_size():
+    spawn_lnxsh()
+    issue("mkfs -b 4096")
+    issue("create arquivo.txt 10")
+    issue("cat arquivo.txt")
+
+    output = do_exit()
+    expected = ("ShellShock Version 0.000003\n"
+                "\n"
+                "# # # ABCDEFGHIJ\n"
+                "# Goodbye\n")
+
+    disk_size = os.path.getsize('disk')
+
+    # superbloco, mapas de bits, 7 blocos de inodes e 1 bloco de dados (o arquivo de 10 bytes fica no inode)
+    if(output.decode() == expected and disk_size == 11 * 4096):
+        print("Sistema de arquivos com blocos de 4096 bytes montado com sucesso")
+
+# Testa a contagem de blocos e inodes livres após criar e remover um arquivo
+def check_df():
+    spawn_lnxsh()
+    issue("mkfs")
+    issue("create arquivo.txt 600")
+    issue("df")
+    issue("unlink arquivo.txt")
+    issue("df")
+
+    output = do_exit()
+    expected = ("ShellShock Version 0.000003\n"
+                "\n"
+                "# # #     Block size       : 512\n"
+                "    Data blocks      : 1989\n"
+                "    Free blocks      : 1986\n"
+                "    Inodes           : 512\n"
+                "    Free inodes      : 510\n"
+                "# #     Block size       : 512\n"
+                "    Data blocks      : 1989\n"
+                "    Free blocks      : 1988\n"
+                "    Inodes           : 512\n"
+                "    Free inodes      : 511\n"
+                "# Goodbye\n")
+
+    if(output.decode() == expected):
+        print("Comando df executado com sucesso")
+
+# Testa o formato de inodes com extents: o arquivo não fica limitado aos blocos diretos e indiretos e o tamanho não inclui blocos de mapeamento
+def check_mkfs_extents():
+    spawn_lnxsh()
+    issue("mkfs -e")
+    issue("create arquivo.txt 70656")
+    issue("stat arquivo.txt")
+
+    output = do_exit()
+    expected = ("ShellShock Version 0.000003\n"
+                "\n"
+                "# # #     Inode No         : 1\n"
+                "    Type             : FILE\n"
+                "    Link Count       : 1\n"
+                "    Size             : 72422\n" # 70656 letras + 1766 quebras de linha
+                "    Blocks allocated : 142\n"
+                "# Goodbye\n")
+
+    if(output.decode() == expected):
+        print("Sistema de arquivos com extents montado com sucesso")
+
+# Testa o mkfs com tamanho de imagem e proporção de inodes: 8192 blocos e 1024 inodes, com mapa de bits de dados ocupando 2 blocos
+def check_mkfs_geometry():
+    spawn_lnxsh()
+    issue("mkfs -s 4M -i 4096")
+    issue("create arquivo.txt 600")
+    issue("df")
+
+    output = do_exit()
+    expected = ("ShellShock Version 0.000003\n"
+                "\n"
+                "# # #     Block size       : 512\n"
+                "    Data blocks      : 8076\n"
+                "    Free blocks      : 8073\n"
+                "    Inodes           : 1024\n"
+                "    Free inodes      : 1022\n"
+                "# Goodbye\n")
+
+    if(output.decode() == expected):
+        print("Sistema de arquivos com 4 MB e 1024 inodes montado com sucesso")
+
+# Testa que o mkfs recusa uma geometria com mais inodes do que cabem em um int (2^36 inodes), sem alterar o disco atual
+def check_mkfs_overflow():
+    spawn_lnxsh()
+    issue("mkfs")
+    issue("create arquivo.txt 1")
+    issue("mkfs -s 1024G -i 16")
+    issue("ls")
+
+    output = do_exit()
+    expected = ("ShellShock Version 0.000003\n"
+                "\n"
+                "# # # mkfs failed\n"
+                "# .\n"
+                "..\n"
+                "arquivo.txt\n"
+                "# Goodbye\n")
+
+    if(output.decode() == expected):
+        print("Geometria grande demais recusada com sucesso")
+
+def check_block_groups():
+    spawn_lnxsh()
+    issue("mkfs -g 256")
+    issue("mkdir a")
+    issue("mkdir b")
+    issue("cd a")
+    issue("create arquivo.txt 600")
+    issue("stat arquivo.txt")
+    issue("cd ..")
+    issue("stat b")
+
+    output = do_exit()
+    expected = ("ShellShock Version 0.000003\n"
+                "\n"
+                "# # OK\n"
+                "# OK\n"
+                "# OK\n"
+                "# #     Inode No         : 65\n"
+                "    Type             : FILE\n"
+                "    Link Count       : 1\n"
+                "    Size             : 615\n"
+                "    Blocks allocated : 2\n"
+                "# OK\n"
+                "#     Inode No         : 128\n"
+                "    Type             : DIRECTORY\n"
+                "    Link Count       : 1\n"
+                "    Size             : 512\n"
+                "    Blocks allocated : 1\n"
+                "# Goodbye\n")
+
+    if(output.decode() == expected):
+        print("Diretórios espalhados pelos grupos de blocos com sucesso")
+
+# Testa que arquivos pequenos ficam no próprio inode, sem ocupar blocos de dados
+def check_inline_data():
+    spawn_lnxsh()
+    issue("mkfs")
+    issue("create arquivo.txt 40")
+    issue("stat arquivo.txt")
+    issue("cat arquivo.txt")
+    issue("df")
+
+    output = do_exit()
+    expected = ("ShellShock Version 0.000003\n"
+                "\n"
+                "# # #     Inode No         : 1\n"
+                "    Type             : FILE\n"
+                "    Link Count       : 1\n"
+                "    Size             : 41\n"
+                "    Blocks allocated : 0\n"
+                "# ABCDEFGHIJKLMNOPQRSTUVWXYZ[\\]^_`abcdeABC\n"
+                "\n"
+                "#     Block size       : 512\n"
+                "    Data blocks      : 1989\n"
+                "    Free blocks      : 1988\n"
+                "    Inodes           : 512\n"
+                "    Free inodes      : 510\n"
+                "# Goodbye\n")
+
+    if(output.decode() == expected):
+        print("Arquivo pequeno guardado no inode com sucesso")
+
+# Testa buscas em um diretório grande o suficiente para ganhar um índice hash, antes e depois de uma remoção
+def check_directory_index():
+    spawn_lnxsh()
+    issue("mkfs")
+    issue("mkdir grande")
+    issue("cd grande")
+
+    for x in range(40):
+        issue("create f%d 1" % x)
+
+    issue("unlink f0")
+    issue("stat f39")
+    issue("stat f0")
+
+    output = do_exit()
+    expected = ("ShellShock Version 0.000003\n"
+                "\n"
+                "# # OK\n"
+                "# OK\n"
+                + "# " * 41 +
+                "#     Inode No         : 41\n"
+                "    Type             : FILE\n"
+                "    Link Count       : 1\n"
+                "    Size             : 1\n"
+                "    Blocks allocated : 0\n"
+                "# Stat failed\n"
+                "# Goodbye\n")
+
+    if(output.decode() == expected):
+        print("Diretório com índice hash consultado com sucesso")
+
+# Testa que buscas repetidas de um nome são resolvidas pela cache de dentries
+def check_dcache():
+    spawn_lnxsh()
+    issue("mkfs")
+    issue("create arquivo.txt 1")
+    issue("stat arquivo.txt")
+    issue("dcache")
+
+    output = do_exit()
+    expected = ("ShellShock Version 0.000003\n"
+                "\n"
+                "# # #     Inode No         : 1\n"
+                "    Type             : FILE\n"
+                "    Link Count       : 1\n"
+                "    Size             : 1\n"
+                "    Blocks allocated : 0\n"
+                "#     Lookups          : 3\n"
+                "    Hits             : 1\n"
+                "    Negative hits    : 1\n"
+                "    Misses           : 1\n"
+                "    Evictions        : 0\n"
+                "    Hit rate         : 66%\n"
+                "# Goodbye\n")
+
+    if(output.decode() == expected):
+        print("Cache de dentries consultada com sucesso")
+
+# Testa o comando bcache: a segunda leitura do bloco de dados, em uma nova sessão, é atendida pela cache de blocos
+def check_bcache():
+    spawn_lnxsh()
+    issue("mkfs")
+    issue("create arquivo.txt 600")
+    do_exit()
+
+    spawn_lnxsh()
+    issue("open arquivo.txt 1")
+    issue("read 0 5")
+    issue("lseek 0 0")
+    issue("read 0 5")
+    issue("bcache")
+
+    output = do_exit()
+    expected = ("ShellShock Version 0.000003\n"
+                "\n"
+                "# File handle is : 0\n"
+                "# Data read in : ABCDE\n"
+                "# OK\n"
+                "# Data read in : ABCDE\n"
+                "#     Accesses         : 8\n"
+                "    Hits             : 1\n"
+                "    Misses           : 7\n"
+                "    Evictions        : 0\n"
+                "    Writebacks       : 0\n"
+                "    Hit rate         : 12%\n"
+                "# Goodbye\n")
+
+    if(output.decode() == expected):
+        print("Cache de blocos consultada com sucesso")
+
+def check_paths():
+    spawn_lnxsh()
+    issue("mkfs")
+    issue("mkdir a")
+    issue("mkdir a/b")
+    issue("create /a/b/arquivo.txt 5")
+    issue("cd a/b")
+    issue("stat ../b/arquivo.txt")
+    issue("cd /")
+    issue("cat a//b/arquivo.txt")
+
+    output = do_exit()
+    expected = ("ShellShock Version 0.000003\n"
+                "\n"
+                "# # OK\n"
+                "# OK\n"
+                "# # OK\n"
+                "#     Inode No         : 3\n"
+                "    Type             : FILE\n"
+                "    Link Count       : 1\n"
+                "    Size             : 5\n"
+                "    Blocks allocated : 0\n"
+                "# OK\n"
+                "# ABCDE\n"
+                "# Goodbye\n")
+
+    if(output.decode() == expected):
+        print("Caminhos resolvidos com sucesso")
+
+# Testa a leitura de um diretório aberto: depois de removido, readdir falha mesmo que o inode seja reaproveitado por outro diretório
+def check_readdir_removed():
+    spawn_lnxsh()
+    issue("mkfs")
+    issue("mkdir d")
+    issue("opendir d")
+    issue("readdir 0")
+    issue("rmdir d")
+    issue("readdir 0")
+    issue("mkdir e")
+    issue("readdir 0")
+    issue("closedir 0")
+
+    output = do_exit()
+    expected = ("ShellShock Version 0.000003\n"
+                "\n"
+                "# # OK\n"
+                "# Directory handle is : 0\n"
+                "# .\n"
+                "..\n"
+                "# OK\n"
+                "# Readdir failed\n"
+                "# OK\n"
+                "# Readdir failed\n"
+                "# OK\n"
+                "# Goodbye\n")
+
+    if(output.decode() == expected):
+        print("Diretório removido enquanto aberto tratado com sucesso")
+
+def check_ls_long():
+    spawn_lnxsh()
+    issue("mkfs")
+    issue("mkdir a")
+    issue("create b 7")
+    issue("ls -l")
+
+    output = do_exit()
+    expected = ("ShellShock Version 0.000003\n"
+                "\n"
+                "# # OK\n"
+                "# # Name                             Type Inode Size\n"
+                ".                                D    0     512\n"
+                "..                               D    0     512\n"
+                "a                                D    1     512\n"
+                "b                                F    2     7\n"
+                "# Goodbye\n")
+
+    if(output.decode() == expected):
+        print("Listagem com atributos executada com sucesso")
+
+# Testa um diretório que passa dos blocos diretos do inode (versão verificada de test_large_dir)
+def check_large_dir():
+    spawn_lnxsh()
+    issue("mkfs")
+    issue("mkdir dir")
+    issue("cd dir")
+    for x in range(1, 501):
+        issue("create f%d 1" %x)
+    issue("cat f1")
+    issue("cat f500")
+    issue("stat f499")
+    issue("cd ..")
+    issue("stat dir")
+
+    output = do_exit()
+    expected = ("ShellShock Version 0.000003\n"
+                "\n"
+                "# # OK\n"
+                "# OK\n"
+                + "# " * 501 + "A\n"
+                "# A\n"
+                "#     Inode No         : 500\n"
+                "    Type             : FILE\n"
+                "    Link Count       : 1\n"
+                "    Size             : 1\n"
+                "    Blocks allocated : 0\n"
+                "# OK\n"
+                "#     Inode No         : 1\n"
+                "    Type             : DIRECTORY\n"
+                "    Link Count       : 1\n"
+                "    Size             : 6144\n"
+                "    Blocks allocated : 13\n"
+                "# Goodbye\n")
+
+    if(output.decode() == expected):
+        print("Diretório com 500 entradas criado com sucesso")
+
+def check_fd_table():
+    spawn_lnxsh()
+    issue("mkfs -f 2")
+    issue("mkdir a")
+    issue("create f 3")
+    issue("link f a/g")
+    issue("open f 2")
+    issue("open a/g 2")
+    issue("open f 1")
+    issue("create h 3")
+    issue("close 0")
+    issue("create h 3")
+    issue("open h 1")
+
+    output = do_exit()
+    expected = ("ShellShock Version 0.000003\n"
+                "\n"
+                "# # OK\n"
+                "# # # File handle is : 0\n"
+                "# File handle is : 1\n"
+                "# File handle is : 0\n"
+                "# Error creating file# OK\n"
+                "# # File handle is : 0\n"
+                "# Goodbye\n")
+
+    if(output.decode() == expected):
+        print("Tabela de descritores com tamanho configurado usada com sucesso")
+
+def check_fd_block_map():
+    spawn_lnxsh()
+    issue("mkfs")
+    issue("mkdir a")
+    issue("create f 1200")
+    issue("link f a/g")
+    issue("open f 3")
+    issue("open a/g 3")
+    issue("lseek 1 1100")
+    issue("read 1 5")
+    issue("write 0 abc")
+    issue("lseek 1 0")
+    issue("read 1 10")
+    issue("lseek 0 1000")
+    issue("write 0 xyz")
+    issue("lseek 1 1000")
+    issue("read 1 10")
+
+    output = do_exit()
+    expected = ("ShellShock Version 0.000003\n"
+                "\n"
+                "# # OK\n"
+                "# # # File handle is : 0\n"
+                "# File handle is : 1\n"
+                "# OK\n"
+                "# Data read in : BCDEF\n"
+                "# Done\n"
+                "# OK\n"
+                "# Data read in : abc\n"
+                "# OK\n"
+                "# Done\n"
+                "# OK\n"
+                "# Data read in : xyz\n"
+                "# Goodbye\n")
+
+    if(output.decode() == expected):
+        print("Mapa de blocos dos descritores atualizado com sucesso")
+
+# Imagem no formato original (antes dos ponteiros indiretos duplos e triplos), equivalente a
+# mkfs; create small 100; create big 6000; mkdir d: blocos de 512 bytes, 512 inodes com 10
+# ponteiros diretos e um indireto simples, e diretórios com entradas de 36 bytes
+def write_baseline_image():
+    def letters(n):
+        data = b""
+        for i in range(n):
+            data += bytes([65 + i % 37])
+            if (i + 1) % 40 == 0:
+                data += b"\r"
+        return data
+
+    def inode(type, size, pointers):
+        return struct.pack("<14i", type, size, 1, *pointers)
+
+    def entry(name, number):
+        return name.encode().ljust(32, b"\0") + struct.pack("<i", number)
+
+    image = bytearray(fs_size_bytes)
+
+    def put(block, data):
+        image[block * 512:block * 512 + len(data)] = data
+
+    big = letters(6000)
+
+    put(0, struct.pack("<5s9i", b"!CFS\0", 2048, 0, 512, 1989, 1, 2, 3, 59, 256))
+    put(1, bytes([0xf0]))
+    put(2, bytes([0xff, 0xff, 0x80]))
+    put(3, inode(1, 180, [59] + [0] * 9 + [-1]) +
+           inode(2, 102, [60] + [-1] * 10) +
+           inode(2, 6662, list(range(61, 72))) +
+           inode(1, 72, [75] + [0] * 9 + [-1]))
+    put(59, entry(".", 0) + entry("..", 0) + entry("small", 1) + entry("big", 2) + entry("d", 3))
+    put(60, letters(100))
+    put(61, big[:5120])
+    put(71, struct.pack("<128i", 72, 73, 74, *([-1] * 125)))
+    put(72, big[5120:])
+    put(75, entry(".", 3) + entry("..", 0))
+
+    with open("disk", "wb") as disk:
+        disk.write(image)
+
+def check_baseline_image():
+    write_baseline_image()
+    spawn_lnxsh()
+    issue("ls")
+    issue("stat big")
+    issue("open big 1")
+    issue("lseek 0 6100")
+    issue("read 0 12")
+    issue("close 0")
+    issue("cd d")
+    issue("create x 3")
+    issue("ls")
+    issue("cd ..")
+    issue("unlink big")
+    issue("df")
+
+    output = do_exit()
+    expected = ("ShellShock Version 0.000003\n"
+                "\n"
+                "# .\n"
+                "..\n"
+                "small\n"
+                "big\n"
+                "d\n"
+                "#     Inode No         : 2\n"
+                "    Type             : FILE\n"
+                "    Link Count       : 1\n"
+                "    Size             : 6150\n"
+                "    Blocks allocated : 14\n"
+                "# File handle is : 0\n"
+                "# OK\n"
+                "# Data read in : abcdeABC\n"
+                "DEF\n"
+                "# OK\n"
+                "# OK\n"
+                "# # .\n"
+                "..\n"
+                "x\n"
+                "# OK\n"
+                "# #     Block size       : 512\n"
+                "    Data blocks      : 1989\n"
+                "    Free blocks      : 1986\n"
+                "    Inodes           : 512\n"
+                "    Free inodes      : 508\n"
+                "# Goodbye\n")
+
+    if(output.decode() == expected):
+        print("Imagem no formato original montada com sucesso")
+
+def check_baseline_image_full():
+    # Imagem original com o disco cheio e um diretório de 28 entradas de nomes longos, que como registros
+    # precisa de um bloco a mais: a montagem é recusada e o disco fica como estava
+    write_baseline_image()
+
+    with open("disk", "rb") as disk:
+        image = bytearray(disk.read())
+
+    entries = b"".join(name.encode().ljust(32, b"\0") + struct.pack("<i", number)
+                       for name, number in [(".", 0), ("..", 0)] + [("n%02d" % i + "x" * 28, 1) for i in range(26)])
+
+    image[3 * 512:3 * 512 + 56] = struct.pack("<14i", 1, len(entries), 1, 59, 76, *([0] * 8), -1)
+    image[59 * 512:60 * 512] = entries[:512]
+    image[76 * 512:77 * 512] = entries[512:].ljust(512, b"\0")
+    image[2 * 512:3 * 512] = b"\xff" * 512
+
+    with open("disk", "wb") as disk:
+        disk.write(image)
+
+    spawn_lnxsh()
+    output = do_exit()
+
+    with open("disk", "rb") as disk:
+        unchanged = disk.read() == image
+
+    if(output.decode().startswith("ShellShock Version 0.000003\n\nDisco com diretórios de entradas fixas sem blocos livres") and unchanged):
+        print("Imagem no formato original sem espaço para a conversão recusada com sucesso")
+
 # Nossos testes (pode levar alguns segundos para rodar todos os testes)
 check_mkfs()
 check_open()
@@ -367,4 +927,22 @@ check_lseek_and_write()
 check_read()
 check_cd()
 check_stat()
-check_file_create()
\ No newline at end of file
+check_file_create()
+check_mkfs_block_size()
+check_df()
+check_mkfs_extents()
+check_mkfs_geometry()
+check_mkfs_overflow()
+check_block_groups()
+check_inline_data()
+check_directory_index()
+check_dcache()
+check_bcache()
+check_paths()
+check_ls_long()
+check_readdir_removed()
+check_large_dir()
+check_fd_table()
+check_fd_block_map()
+check_baseline_image_full()
+check_baseline_image()